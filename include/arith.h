@@ -0,0 +1,35 @@
+/**
+ * @file arith.h
+ * @brief Shell arithmetic
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _ARITH_H
+#define _ARITH_H
+
+/**** DEFINITIONS ****/
+
+#define ARITH_MAX_DEPTH                         32      // Maximum variable indirection depth
+
+/**** TYPES ****/
+
+typedef struct arith {
+    char *expr;                         // Whole expression (for error messages)
+    char *p;                            // Current position
+    int error;                          // Set on error
+    int noeval;                         // Nonzero while evaluating a short-circuited branch
+    int depth;                          // Indirection depth
+} arith_t;
+
+/**** FUNCTIONS ****/
+
+int arith_evaluate(char *expr, long long *result);
+
+#endif
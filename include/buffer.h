@@ -32,5 +32,6 @@ void buffer_push(buffer_t *buf, int ch);
 int buffer_pop(buffer_t *buf);
 void buffer_destroy(buffer_t *buf);
 void buffer_pushString(buffer_t *buf, char *str);
+void buffer_append(buffer_t *buf, const char *data, size_t length);
 
 #endif
\ No newline at end of file
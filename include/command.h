@@ -26,11 +26,14 @@
 #define COMMAND_FLAG_JOB            0x04    // This command is a job
 #define COMMAND_FLAG_PIPE_FROM_PREV 0x08    // This command's stdin comes from previous via pipe
 
+#define COMMAND_REDIRECT_APPEND     0x01    // Append to the file instead of truncating it
+
 /**** TYPES ****/
 
 typedef struct command {
     int argc;                   // Argument count
     char **argv;                // Argument list
+    int argv_size;              // Allocated size of argv
     int envc;                   // Additional environ count
     char **additional_envp;     // Additional environs
 
@@ -52,6 +55,7 @@ typedef struct builtin {
 /**** VARIABLES ****/
 
 extern int cmd_last_exit_status;
+extern int cmd_job_control;
 extern int cmd_last_signalled;
 
 extern builtin_t builtin_list[];
@@ -59,9 +63,9 @@ extern const int builtin_list_size;
 
 /**** MACROS ****/
 
-#define COMMAND_INIT(cmd) ({  (cmd)->argc = 0; (cmd)->additional_envp = NULL; (cmd)->stdin = -1; (cmd)->stdout = -1; (cmd)->stderr = -1; (cmd)->argv = malloc(sizeof(char*)); (cmd)->argv[0] = NULL; (cmd)->exec_flags = 0x0; (cmd)->envc = 0; })
+#define COMMAND_INIT(cmd) ({  (cmd)->argc = 0; (cmd)->additional_envp = NULL; (cmd)->stdin = -1; (cmd)->stdout = -1; (cmd)->stderr = -1; (cmd)->argv = malloc(sizeof(char*)); (cmd)->argv[0] = NULL; (cmd)->argv_size = 1; (cmd)->exec_flags = 0x0; (cmd)->envc = 0; })
 #define COMMAND_LIST_INIT() ({ command_t *cmd = malloc(sizeof(command_t)); COMMAND_INIT(cmd); cmd; })
-#define COMMAND_PUSH_ARGV(cmd, arg) ({ (cmd)->argc++; (cmd)->argv = realloc((cmd)->argv, ((cmd)->argc+1) * sizeof(char*)); (cmd)->argv[(cmd)->argc-1] = arg; (cmd)->argv[(cmd)->argc] = NULL; })
+#define COMMAND_PUSH_ARGV(cmd, arg) ({ (cmd)->argc++; if ((cmd)->argc + 1 > (cmd)->argv_size) { (cmd)->argv_size *= 2; (cmd)->argv = realloc((cmd)->argv, (cmd)->argv_size * sizeof(char*)); } (cmd)->argv[(cmd)->argc-1] = arg; (cmd)->argv[(cmd)->argc] = NULL; })
 #define COMMAND_PUSH_ENVIRON(cmd, env) ({ (cmd)->envc++; if (!(cmd)->additional_envp) { (cmd)->additional_envp = malloc(sizeof(char*) * ((cmd)->envc+1)); (cmd)->additional_envp[1] = NULL; } else { (cmd)->additional_envp = realloc((cmd)->additional_envp, sizeof(char*) * ((cmd)->envc + 1)); }; (cmd)->additional_envp[(cmd)->envc-1] = env; (cmd)->additional_envp[(cmd)->envc] = NULL; })
 
 #define COMMAND_NEW(list, new_count) ({ list = realloc(list, new_count * sizeof(command_t)); COMMAND_INIT((&list[new_count-1])); })
@@ -70,6 +74,7 @@ extern const int builtin_list_size;
 
 int command_execute(command_t *command);
 void command_executeList(command_t *command, size_t command_count);
+int command_redirect(command_t *command, int fd, int flags, char *path);
 void command_cleanup(command_t *command);
 
 #endif
\ No newline at end of file
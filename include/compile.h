@@ -0,0 +1,85 @@
+/**
+ * @file compile.h
+ * @brief Script compiler
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _COMPILE_H
+#define _COMPILE_H
+
+/**** INCLUDES ****/
+#include "vm.h"
+#include "buffer.h"
+#include "token.h"
+#include <sys/types.h>
+#include <time.h>
+
+/**** DEFINITIONS ****/
+
+#define COMPILE_INITIAL_STRINGS_SIZE            256
+
+/**** TYPES ****/
+
+typedef struct compile {
+    vm_instruction_t *code;             // Instructions
+    size_t code_count;                  // Number of instructions
+    size_t code_size;                   // Allocated instructions
+    buffer_t *pool;                     // String pool
+    uint32_t *strings;                  // Open-addressing table of pool offset + 1, to share strings
+    size_t strings_size;                // Size of the table
+    size_t string_count;                // Strings in the pool
+    buffer_t *literal;                  // Literal text not yet emitted
+    int literal_reg;                    // Register the literal text belongs to
+    int line;                           // Source line of the last VM_OP_LINE
+
+    int quoted;                         // Inside double or single quotes
+    int single_quoted;                  // Inside single quotes
+    int redirect;                       // Pending redirection fd (and VM_REDIRECT_APPEND), -1 if none
+    int argc;                           // Words in the current command
+    int word;                           // The current word has contents
+    int pending;                        // Instructions were emitted since the last VM_OP_EXECUTE
+    int compound;                       // The current command is a finished if/while
+    int error;                          // Set on a syntax error
+    int errors;                         // Syntax errors found
+    int check;                          // Only checking syntax, keep going after errors and drop the strings
+} compile_t;
+
+typedef struct compile_cache {
+    dev_t dev;                          // Device of the script
+    ino_t ino;                          // Inode of the script
+    off_t size;                         // Size of the script when it was compiled
+    struct timespec mtime;              // Modification time of the script when it was compiled
+    char *image;                        // Compiled script (header, code and pool)
+    vm_program_t program;               // Program in the image
+    int interpret;                      // It has syntax errors, run it with the interpreter (there is no image)
+    int running;                        // Number of times it is running right now
+    int stale;                          // Replaced by a newer compile, freed when it stops running
+    struct compile_cache *next;         // Next entry
+} compile_cache_t;
+
+typedef struct compile_stats {
+    size_t files;                       // Scripts checked
+    size_t lines;                       // Lines parsed
+    size_t bytes;                       // Bytes parsed
+    size_t errors;                      // Syntax errors found
+} compile_stats_t;
+
+/**** FUNCTIONS ****/
+
+void compile_init(compile_t *c, int check);
+int compile_line(compile_t *c);
+void compile_program(compile_t *c, vm_program_t *program);
+void compile_destroy(compile_t *c);
+int compile_file(char *source, char *output);
+int compile_check(char *filename, compile_stats_t *stats);
+compile_cache_t *compile_cached(char *filename);
+void compile_release(compile_cache_t *entry);
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * @file complete.h
+ * @brief Tab completion
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _COMPLETE_H
+#define _COMPLETE_H
+
+/**** INCLUDES ****/
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "pattern.h"
+
+/**** DEFINITIONS ****/
+
+#define COMPLETE_INITIAL_MATCHES                32
+#define COMPLETE_MAX_MATCHES                    1024    // A Tab stops looking after this many matches
+#define COMPLETE_MAX_CANDIDATES                 262144  // Fuzzy matching looks at up to this many names
+#define COMPLETE_THREADS                        4       // PATH directories read at once
+#define COMPLETE_INITIAL_USES                   256
+
+/* Fuzzy match scores */
+#define COMPLETE_SCORE_MATCH                    16      // Each character of the word
+#define COMPLETE_SCORE_BOUNDARY                 8       // ... at the start of the name or after - _ . /
+#define COMPLETE_SCORE_CONSECUTIVE              12      // ... right after the one before
+#define COMPLETE_SCORE_CASE                     1       // ... in the same case
+#define COMPLETE_SCORE_GAP_MAX                  8       // Most taken off for the characters skipped between two
+#define COMPLETE_SCORE_USE                      4       // Each time the name was used (up to COMPLETE_SCORE_USES)
+#define COMPLETE_SCORE_USES                     8
+#define COMPLETE_SCORE_HOUR                     16      // Used in the last hour
+#define COMPLETE_SCORE_DAY                      8       // Used in the last day
+
+/* What a completion spec completes besides its words (complete -f, -d) */
+#define COMPLETE_SPEC_FILES                     0x01    // Files (and directories, to get to them)
+#define COMPLETE_SPEC_DIRS                      0x02    // Directories
+
+/**** TYPES ****/
+
+typedef struct complete_dir {
+    char *path;                         // PATH directory
+    struct timespec mtime;              // Modification time when it was read, adding or removing names changes it
+    int read;                           // It was read (it may not exist)
+    char **names;                       // Executables in it
+    size_t count;                       // Number of executables
+    size_t entries;                     // Entries looked at when it was read
+    size_t stats;                       // stat() calls needed when it was read
+} complete_dir_t;
+
+typedef struct complete_cache {
+    char *dir;                          // Directory part of the word (NULL if nothing is cached)
+    char *prefix;                       // Name part the matches are for
+    int commands;                       // Commands in PATH were matched too
+    dev_t dev;                          // Directory that was read
+    ino_t ino;
+    struct timespec mtime;              // Its modification time when it was read
+    unsigned long index_version;        // PATH index the commands came from
+    size_t limit;                       // Matches it stops at
+    int truncated;                      // Stopped at the limit
+    char **matches;                     // Matches, NULL-terminated
+    size_t count;                       // Number of matches
+    size_t size;                        // Allocated matches
+    uint64_t *masks;                    // Characters in each match, for fuzzy matching
+    int masked;                         // The masks are up to date
+} complete_cache_t;
+
+typedef struct complete_spec {
+    char *name;                         // Command the arguments of which it completes
+    int flags;                          // COMPLETE_SPEC_*
+    char *wordlist;                     // -W, as given
+    char **words;                       // The words of it, sorted
+    size_t word_count;
+    char *command;                      // -C, a command printing candidates one per line
+    int ttl;                            // -t, seconds the output of the command is kept
+    char **output;                      // Its last output, sorted
+    size_t output_count;
+    time_t output_time;                 // When it was run
+    char *filter;                       // -X, files matching it are left out ("!..." keeps only those)
+    pattern_t *filter_pattern;          // It compiled, without any '!'
+    struct complete_spec *next;         // Next spec
+} complete_spec_t;
+
+typedef struct complete_use {
+    char *name;                         // Word used on a command line
+    unsigned int hash;                  // Hash of it
+    unsigned int count;                 // Times it was used
+    time_t last;                        // When it was last used
+} complete_use_t;
+
+typedef struct complete_rank {
+    int score;                          // How well it matches, higher is better
+    const char *name;                   // Candidate
+} complete_rank_t;
+
+typedef struct complete_stats {
+    size_t tabs;                        // Completions done
+    size_t last_us;                     // Time the last one took
+    size_t max_us;                      // Longest one
+    size_t entries;                     // Directory entries the last one looked at
+    size_t stats;                       // stat() calls the last one needed
+    size_t cached;                      // Completions answered from the last one's matches
+    size_t scored;                      // Candidates the last fuzzy completion scored
+} complete_stats_t;
+
+/**** VARIABLES ****/
+
+extern complete_stats_t complete_stats;
+
+/**** MACROS ****/
+
+#define COMPLETE_FOLD(c)                (((c) >= 'A' && (c) <= 'Z') ? (c) + ('a' - 'A') : (c))
+
+/**** FUNCTIONS ****/
+
+const char **complete_findCommands(const char *prefix, size_t *count);
+char **complete_word(char *str, const char *command, size_t *count, int *ranked, int *truncated);
+void complete_getStats(char *buffer, size_t size);
+void complete_remember(const char *line);
+complete_spec_t *complete_listSpecs();
+void complete_setSpec(const char *name, int flags, const char *wordlist, const char *command, int ttl, const char *filter);
+int complete_removeSpec(const char *name);
+
+#endif
@@ -0,0 +1,70 @@
+/**
+ * @file edit.h
+ * @brief Line editing buffer and kill ring
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _EDIT_H
+#define _EDIT_H
+
+/**** INCLUDES ****/
+#include <stddef.h>
+
+/**** DEFINITIONS ****/
+
+#define EDIT_INITIAL_SIZE                       512
+#define EDIT_KILL_RING_SIZE                     16
+
+/* How a kill joins the newest kill ring entry */
+#define EDIT_KILL_NEW                           0       // Start a new entry
+#define EDIT_KILL_APPEND                        1       // Killed forward right after another kill
+#define EDIT_KILL_PREPEND                       2       // Killed backward right after another kill
+
+/**** TYPES ****/
+
+typedef struct edit_line {
+    char *data;                         // Text before the cursor, the gap, then text after the cursor
+    size_t size;                        // Allocated size
+    size_t gap_start;                   // Start of the gap, which is the cursor
+    size_t gap_end;                     // End of the gap
+} edit_line_t;
+
+typedef struct edit_kill_ring {
+    char *entries[EDIT_KILL_RING_SIZE]; // Killed text
+    size_t head;                        // Newest entry
+    size_t count;                       // Entries in use
+    size_t yank;                        // Entry last yanked, for yank-pop
+} edit_kill_ring_t;
+
+/**** MACROS ****/
+
+#define EDIT_LENGTH(e)                  ((e)->size - ((e)->gap_end - (e)->gap_start))
+#define EDIT_CURSOR(e)                  ((e)->gap_start)
+#define EDIT_AFTER(e)                   ((e)->data + (e)->gap_end)
+#define EDIT_AFTER_LENGTH(e)            ((e)->size - (e)->gap_end)
+
+/**** FUNCTIONS ****/
+
+void edit_init(edit_line_t *e);
+void edit_clear(edit_line_t *e);
+int edit_at(edit_line_t *e, size_t index);
+void edit_moveTo(edit_line_t *e, size_t position);
+void edit_insert(edit_line_t *e, const char *text, size_t length);
+void edit_erase(edit_line_t *e, size_t from, size_t to);
+void edit_set(edit_line_t *e, const char *text, size_t length);
+char *edit_copy(edit_line_t *e, size_t from, size_t to);
+size_t edit_wordLeft(edit_line_t *e, size_t position, int spaces_only);
+size_t edit_wordRight(edit_line_t *e, size_t position);
+
+void edit_kill(edit_kill_ring_t *ring, char *text, int how);
+const char *edit_yank(edit_kill_ring_t *ring);
+const char *edit_yankPop(edit_kill_ring_t *ring);
+
+#endif
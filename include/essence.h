@@ -21,6 +21,16 @@
 #include "parser.h"
 #include "command.h"
 #include "buffer.h"
+#include "pattern.h"
+#include "expand.h"
+#include "variable.h"
+#include "arith.h"
+#include "vm.h"
+#include "compile.h"
+#include "edit.h"
+#include "prompt.h"
+#include "complete.h"
+#include "history.h"
 
 /**** DEFINITIONS ****/
 
@@ -28,10 +38,20 @@
 #define ESSENCE_VERSION_MINOR       0
 #define ESSENCE_VERSION_LOWER       0
 
+#define ESSENCE_OPTION_NULLGLOB     0x01    // Patterns that match nothing expand to nothing
+#define ESSENCE_OPTION_DOTGLOB      0x02    // Patterns match names beginning with a dot
+#define ESSENCE_OPTION_GLOBSTAR     0x04    // ** matches any number of directories
+#define ESSENCE_OPTION_FUZZY        0x08    // Tab matches names containing the word's characters in order, best first
+
 /**** VARIABLES ****/
 
 extern int essence_argc;
 extern char **essence_argv;
 extern int essence_pid;
+extern int essence_options;
+
+/**** FUNCTIONS ****/
+
+int essence_runScript(char *filename);
 
 #endif
\ No newline at end of file
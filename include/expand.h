@@ -0,0 +1,55 @@
+/**
+ * @file expand.h
+ * @brief Word expansion
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _EXPAND_H
+#define _EXPAND_H
+
+/**** INCLUDES ****/
+#include "command.h"
+#include "pattern.h"
+#include "buffer.h"
+#include "variable.h"
+
+/**** DEFINITIONS ****/
+
+#define EXPAND_CTLESC                           PATTERN_CTLESC
+#define EXPAND_CTLSPLIT                         '\002' // Field boundary left by "$@" and "${a[@]}"
+
+#define EXPAND_DIRENT_BUFFER_SIZE               32768
+
+#define EXPAND_FLAG_QUOTED                      0x01    // Expansion is inside double quotes
+#define EXPAND_FLAG_RAW                         0x02    // Never mark characters (assignment values)
+
+/**** MACROS ****/
+
+/* Characters that must be escaped with EXPAND_CTLESC when they appear quoted in a word */
+#define EXPAND_IS_META(ch) ((ch) == '*' || (ch) == '?' || (ch) == '[' || (ch) == ']' || (ch) == '\\' || (ch) == '{' || (ch) == '}' || (ch) == ',' || (ch) == EXPAND_CTLESC || (ch) == EXPAND_CTLSPLIT)
+
+/**** FUNCTIONS ****/
+
+void expand_pushWord(command_t *cmd, char *word);
+char *expand_removeQuotes(char *word);
+int expand_glob(command_t *cmd, char *word);
+
+void expand_pushValue(buffer_t *out, const char *str, size_t length, int flags);
+size_t expand_nameLength(const char *str);
+void expand_variable(char *name, buffer_t *out, int flags);
+void expand_special(int ch, buffer_t *out, int flags);
+int expand_parameter(char *expr, buffer_t *out, int flags);
+int expand_commandSubstitution(char *cmd, buffer_t *out, int flags);
+int expand_arithmetic(char *expr, buffer_t *out, int flags);
+int expand_substitution(char *body, buffer_t *out, int flags);
+int expand_compoundAssign(variable_t *v, char *list);
+void expand_string(char *str, buffer_t *out, int flags);
+
+#endif
@@ -0,0 +1,57 @@
+/**
+ * @file history.h
+ * @brief Command history and the history file
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+/**** INCLUDES ****/
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**** DEFINITIONS ****/
+
+#define HISTORY_DEFAULT_SIZE                    1000    // Entries kept when HISTSIZE/HISTFILESIZE aren't set
+#define HISTORY_FILE_NAME                       ".history"
+#define HISTORY_SET_DELETED                     ((size_t)-1)    // Set cell of a removed line
+#define HISTORY_INITIAL_POSTINGS                4096
+#define HISTORY_SEARCH_GRAM                     3       // Characters in the pieces lines are indexed by
+
+/**** TYPES ****/
+
+typedef struct history_entry {
+    char *line;                         // The command line, without its newline (NULL if erased)
+    unsigned int hash;                  // Hash of it
+    uint32_t id;                        // Number in the search index, higher for newer entries
+    time_t time;                        // When it was run, 0 if not known
+} history_entry_t;
+
+typedef struct history_posting {
+    uint32_t trigram;                   // Three characters, 0 if the cell is free
+    uint32_t count;                     // Entries that have it
+    uint32_t size;                      // Allocated ids
+    uint32_t *ids;                      // Their ids, ascending
+} history_posting_t;
+
+/**** FUNCTIONS ****/
+
+void history_load();
+void history_flush();
+char *history_get(int index);
+void history_append(char *str);
+size_t history_count();
+history_entry_t *history_entry(size_t index);
+void history_clear();
+int history_search(const char *query, int from, int backward);
+
+#endif
@@ -21,33 +21,122 @@
 
 #define INPUT_TYPE_INTERACTIVE                  0
 #define INPUT_TYPE_SCRIPT                       1
+#define INPUT_TYPE_STREAM                       2       // Non-interactive stdin
 
 #define INPUT_PROMPT_PS1                        0
 #define INPUT_PROMPT_PS2                        1
 
 #define INPUT_DEFAULT_BUFFER_SIZE               512
+#define INPUT_READ_CHUNK_SIZE                   65536
+#define INPUT_PEEK_SIZE                         4096
+#define INPUT_KEY_CHUNK_SIZE                    4096
+
+/* Keys other than characters */
+#define INPUT_KEY_NONE                          0x100   // Unknown escape sequence
+#define INPUT_KEY_UP                            0x101
+#define INPUT_KEY_DOWN                          0x102
+#define INPUT_KEY_RIGHT                         0x103
+#define INPUT_KEY_LEFT                          0x104
+#define INPUT_KEY_HOME                          0x105
+#define INPUT_KEY_END                           0x106
+#define INPUT_KEY_DELETE                        0x107
+#define INPUT_KEY_WORD_LEFT                     0x108   // Alt-B, Ctrl/Alt-Left
+#define INPUT_KEY_WORD_RIGHT                    0x109   // Alt-F, Ctrl/Alt-Right
+#define INPUT_KEY_KILL_WORD                     0x10A   // Alt-D
+#define INPUT_KEY_RUBOUT_WORD                   0x10B   // Alt-Backspace
+#define INPUT_KEY_YANK_POP                      0x10C   // Alt-Y
+#define INPUT_KEY_PASTE                         0x10D   // Start of a bracketed paste
+#define INPUT_KEY_BACK_TAB                      0x10E   // Shift-Tab
+
+/* Markers of prompt text that takes no room on the screen (\[ and \] in PS1) */
+#define INPUT_PROMPT_HIDE_START                 '\001'
+#define INPUT_PROMPT_HIDE_END                   '\002'
+
+/* Bracketed paste */
+#define INPUT_PASTE_ON                          "\033[?2004h"
+#define INPUT_PASTE_OFF                         "\033[?2004l"
+#define INPUT_PASTE_END                         "\033[201~"
+
+#define INPUT_STREAM_SEEK                       0       // Block reads, seek back unconsumed input
+#define INPUT_STREAM_PEEK                       1       // Peek pipes with tee(), consume whole lines
+#define INPUT_STREAM_BYTE                       2       // Read a byte at a time
+
+/**** TYPES ****/
+
+typedef struct input_script {
+    char *name;                         // Script name, for error messages
+    char *data;                         // Script contents
+    size_t length;                      // Length of the contents
+    size_t offset;                      // Offset of the next line
+    size_t map_length;                  // Length of the mapping, 0 if the contents were read
+    int borrowed;                       // The contents belong to the caller (-c strings)
+    int line;                           // Line number of the current line
+} input_script_t;
+
+typedef struct input_stream {
+    int fd;                             // File descriptor
+    int mode;                           // INPUT_STREAM_*
+    char *window;                       // Read (SEEK) or peeked (PEEK) input not yet handed out
+    size_t window_size;                 // Allocated size of the window
+    size_t start;                       // Start of unconsumed input in the window
+    size_t end;                         // End of valid input in the window
+    char *line;                         // Line buffer (PEEK/BYTE)
+    size_t line_size;                   // Allocated size of the line buffer
+    int peek_pipe[2];                   // Pipe that tee() duplicates input into
+    int line_number;                    // Line number of the current line
+} input_stream_t;
+
+typedef struct input_state {
+    char *buffer;                       // Current line
+    size_t buffer_idx;                  // Position in the line
+    size_t buffer_len;                  // Length of the line
+    size_t buffer_size;                 // Allocated size of the line
+    int borrowed;                       // The line belongs to the script
+    int unread;                         // Ungot character
+    void *unget_token;                  // Ungot lexer token
+    int type;                           // Input type
+    input_script_t *script;             // Script being read
+} input_state_t;
+
+typedef struct input_edit_stats {
+    size_t keystrokes;                  // Keys read by the line editor
+    size_t bytes;                       // Bytes written to the terminal
+    size_t writes;                      // write() calls made to write them
+} input_edit_stats_t;
 
 /**** VARIABLES ****/
 
 extern int essence_input_type;
 extern int essence_prompt;
 
-extern FILE *input_script;
+extern input_script_t *input_script;
+extern input_edit_stats_t input_edit_stats;
+
+/**** MACROS ****/
+
+#define INPUT_CTRL(ch)                          ((ch) & 0x1f)
 
 /**** FUNCTIONS ****/
 
 void input_init();
+void input_editStats(char *buffer, size_t size);
 char *input_get(char *prompt);
 int input_getCharacter();
 void input_ungetCharacter(int ch);
-char *input_getPrompt();
+const char *input_getPrompt();
 int input_loadScript(char *filename);
+int input_loadString(const char *name, char *string);
+void input_unloadScript();
+int input_loadStream(int fd);
+void input_sync();
+int input_getLine();
+int input_getColumn();
+void input_setLine(int line);
+const char *input_getName();
 int input_loadBuffer(char *buffer);
 void input_unloadBuffer();
 void input_switchInteractive();
-
-void history_load();
-char *history_get(int index);
-void history_append(char *str);
+void input_save(input_state_t *state);
+void input_restore(input_state_t *state);
 
 #endif
\ No newline at end of file
@@ -17,6 +17,10 @@
 /**** INCLUDES ****/
 #include "token.h"
 
+/**** VARIABLES ****/
+
+extern token_t *lexer_unget;
+
 /**** FUNCTIONS ****/
 
 token_t *lexer_getToken(token_t *prev);
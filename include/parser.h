@@ -17,9 +17,20 @@
 /**** INCLUDES ****/
 #include "token.h"
 
+/**** VARIABLES ****/
+
+extern int parser_check_only;
+extern int parser_quiet;
+
 /**** FUNCTIONS ****/
 
 void parser_interpret();
+void parser_errorPrefix();
+void parser_errorPrefixAt(int column);
+void parser_error(int column, const char *format, ...);
 void parser_syntaxError(token_t *tok);
+void parser_reset();
+char *parser_readBalanced(int open, int close);
+char *parser_readList();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,55 @@
+/**
+ * @file pattern.h
+ * @brief Compiled shell patterns
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _PATTERN_H
+#define _PATTERN_H
+
+/**** INCLUDES ****/
+#include <stddef.h>
+
+/**** DEFINITIONS ****/
+
+#define PATTERN_CTLESC                          '\001'  // Marks the next character as quoted
+
+#define PATTERN_NODE_LITERAL                    0       // Run of literal characters
+#define PATTERN_NODE_ANY                        1       // ?
+#define PATTERN_NODE_STAR                       2       // *
+#define PATTERN_NODE_CLASS                      3       // [...]
+
+#define PATTERN_FLAG_MAGIC                      0x01    // Pattern contains wildcards
+#define PATTERN_FLAG_DOT                        0x02    // Pattern begins with a literal dot
+
+/**** TYPES ****/
+
+typedef struct pattern_node {
+    int type;                           // Node type
+    size_t length;                      // Literal length
+    char *literal;                      // Literal characters (points into pool)
+    unsigned char set[32];              // Character class bitmap
+} pattern_node_t;
+
+typedef struct pattern {
+    pattern_node_t *nodes;              // Compiled nodes
+    size_t node_count;                  // Node count
+    char *pool;                         // Unescaped literal characters
+    int flags;                          // Pattern flags
+} pattern_t;
+
+/**** FUNCTIONS ****/
+
+pattern_t *pattern_compile(const char *str, size_t length);
+int pattern_match(pattern_t *pat, const char *str, size_t length);
+int pattern_hasMagic(const char *str, size_t length);
+void pattern_destroy(pattern_t *pat);
+
+#endif
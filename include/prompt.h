@@ -0,0 +1,79 @@
+/**
+ * @file prompt.h
+ * @brief Compiled PS1/PS2 prompts
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _PROMPT_H
+#define _PROMPT_H
+
+/**** INCLUDES ****/
+#include "buffer.h"
+#include <stddef.h>
+#include <poll.h>
+#include <sys/types.h>
+
+/**** DEFINITIONS ****/
+
+#define PROMPT_OP_TEXT                          0       // Literal text, including what never changes (\u, \h, \$, ...)
+#define PROMPT_OP_DATE                          1       // \d
+#define PROMPT_OP_TIME_24                       2       // \t
+#define PROMPT_OP_TIME_12                       3       // \T
+#define PROMPT_OP_TIME_AMPM                     4       // \@
+#define PROMPT_OP_CWD                           5       // \w
+#define PROMPT_OP_CWD_BASE                      6       // \W
+#define PROMPT_OP_STATUS                        7       // \+, red or green for the last exit status
+#define PROMPT_OP_SEGMENT                       8       // \{NAME}, output of a command run in the background
+
+#define PROMPT_INITIAL_OPS                      16
+
+#define PROMPT_SEGMENT_TIMEOUT                  2000    // Default milliseconds a segment command may run
+#define PROMPT_SEGMENT_MAX                      256     // Bytes of a segment's output that are kept
+#define PROMPT_POLL_MAX                         16      // Segment commands waited on at once
+
+/**** TYPES ****/
+
+typedef struct prompt_op {
+    int type;                           // PROMPT_OP_*
+    size_t offset;                      // Text: start in the prompt's text
+    size_t length;                      // Text: length
+} prompt_op_t;
+
+typedef struct prompt_segment {
+    char *name;                         // Segment name
+    char *cwd;                          // Working directory it ran in, results are cached per directory
+    char *value;                        // Last known output, NULL if there is none yet
+    pid_t pid;                          // Running command (and its process group), 0 if none
+    int fd;                             // Read end of its output, -1 once it closed
+    buffer_t *output;                   // Output read so far
+    long long deadline;                 // When it gets killed (CLOCK_MONOTONIC milliseconds)
+    unsigned long epoch;                // Prompt it was last started for
+    struct prompt_segment *next;        // Next segment
+} prompt_segment_t;
+
+typedef struct prompt {
+    char *source;                       // PS string it was compiled from
+    buffer_t *text;                     // Literal text of all the ops
+    prompt_op_t *ops;                   // Ops, in order
+    size_t op_count;                    // Ops in use
+    size_t op_size;                     // Allocated ops
+    int time;                           // Some op needs the time
+    buffer_t *out;                      // Last render
+} prompt_t;
+
+/**** FUNCTIONS ****/
+
+const char *prompt_render(prompt_t *p, const char *source);
+void prompt_setCwd();
+void prompt_next();
+size_t prompt_pollFds(struct pollfd *fds, size_t max, int *timeout);
+int prompt_update();
+
+#endif
@@ -37,12 +37,14 @@
 #define TOKEN_TYPE_CLOSE_PAREN                  18
 #define TOKEN_TYPE_EQUALS                       19
 #define TOKEN_TYPE_TILDE                        20
+#define TOKEN_TYPE_REDIRECT_APPEND              21
 
 /**** TYPES ****/
 
 typedef struct token {
     int type;                           // Token type
     char *value;                        // Token value
+    int column;                         // Column of its first character
 } token_t;
 
 /**** FUNCTIONS ****/
@@ -0,0 +1,90 @@
+/**
+ * @file variable.h
+ * @brief Shell variable store
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _VARIABLE_H
+#define _VARIABLE_H
+
+/**** INCLUDES ****/
+#include <stddef.h>
+
+/**** DEFINITIONS ****/
+
+#define VARIABLE_FLAG_EXPORT                    0x01    // Variable is passed to commands
+#define VARIABLE_FLAG_READONLY                  0x02    // Variable can't be assigned or unset
+#define VARIABLE_FLAG_INTEGER                   0x04    // Assignments are evaluated arithmetically
+
+#define VARIABLE_TYPE_SCALAR                    0
+#define VARIABLE_TYPE_INDEXED                   1       // Indexed array
+#define VARIABLE_TYPE_ASSOC                     2       // Associative array
+
+#define VARIABLE_INITIAL_TABLE_SIZE             256
+
+/* Marks the value of a NAME=(...) statement, which is followed by the raw list */
+#define VARIABLE_COMPOUND                       '\003'
+
+/**** TYPES ****/
+
+typedef struct variable_element {
+    char *key;                          // Key (associative arrays only)
+    long long index;                    // Index (indexed arrays only)
+    char *value;                        // Value, NULL if unset
+    unsigned int hash;                  // Hash of key
+} variable_element_t;
+
+typedef struct variable_array {
+    variable_element_t *elements;       // Indexed: element i is index i, or sorted by index if sparse. Associative: insertion order.
+    size_t element_count;               // Used elements (indexed and not sparse: highest index + 1)
+    size_t element_size;                // Allocated elements
+    size_t *index;                      // Associative only: open-addressing table of element index + 1
+    size_t index_size;                  // Size of the index table
+    size_t count;                       // Number of set elements
+    int sparse;                         // Indexed only: the elements are just the set ones, too far apart for a vector
+} variable_array_t;
+
+typedef void (*variable_getter_t)(char *buffer, size_t size);
+
+typedef struct variable {
+    char *value;                        // Value, NULL if unset
+    size_t value_size;                  // Allocated size of value
+    int flags;                          // Variable flags
+    int type;                           // Variable type
+    variable_array_t *array;            // Array storage, if this is an array
+    variable_getter_t getter;           // Computes the value whenever it is read (read-only variables only)
+    unsigned int hash;                  // Hash of name
+    char name[];                        // Name (allocated once, never moves)
+} variable_t;
+
+/**** FUNCTIONS ****/
+
+void variable_init(char **envp);
+variable_t *variable_find(const char *name);
+variable_t *variable_create(const char *name);
+variable_t *variable_dynamic(const char *name, variable_getter_t getter);
+const char *variable_get(const char *name);
+int variable_set(const char *name, const char *value);
+int variable_assign(const char *statement);
+int variable_setFlags(const char *name, int set, int clear);
+int variable_unset(const char *name);
+char **variable_environ();
+variable_t *variable_declareArray(const char *name, int type);
+int variable_clearArray(variable_t *v);
+int variable_setIndex(variable_t *v, long long index, const char *value, int append);
+long long variable_nextIndex(variable_t *v);
+int variable_setElement(variable_t *v, const char *key, const char *value, int append);
+const char *variable_getElement(variable_t *v, const char *key);
+int variable_unsetElement(variable_t *v, const char *key);
+variable_element_t *variable_iterate(variable_t *v, size_t *cursor);
+size_t variable_count(variable_t *v);
+variable_t **variable_list(size_t *count);
+
+#endif
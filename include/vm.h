@@ -0,0 +1,86 @@
+/**
+ * @file vm.h
+ * @brief Bytecode format and virtual machine for precompiled scripts
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#ifndef _VM_H
+#define _VM_H
+
+/**** INCLUDES ****/
+#include <stddef.h>
+#include <stdint.h>
+
+/**** DEFINITIONS ****/
+
+#define VM_MAGIC                                "\177ESC"
+#define VM_VERSION                              1
+
+/* Registers words are built in */
+#define VM_REGISTERS                            2
+#define VM_REG_WORD                             0       // Current word (or assignment name)
+#define VM_REG_VALUE                            1       // Assignment value
+
+/* Opcodes. k is the string at pool offset arg. */
+#define VM_OP_END                               0       // Stop
+#define VM_OP_LINE                              1       // Source line is now arg
+#define VM_OP_LITERAL                           2       // reg += k
+#define VM_OP_VARIABLE                          3       // reg += $k
+#define VM_OP_SPECIAL                           4       // reg += $arg (a special parameter character)
+#define VM_OP_PARAMETER                         5       // reg += ${k}
+#define VM_OP_SUBSTITUTE                        6       // reg += $(k)
+#define VM_OP_HOME                              7       // reg += $HOME
+#define VM_OP_WORD                              8       // Push reg as arguments of the current command
+#define VM_OP_ASSIGN                            9       // Push WORD=VALUE as an assignment of the current command
+#define VM_OP_REDIRECT                          10      // Redirect the fd in flags of the current command to reg
+#define VM_OP_COMMAND                           11      // Start a new command with exec flags
+#define VM_OP_EXECUTE                           12      // Execute the command list
+#define VM_OP_JUMP                              13      // Jump to arg
+#define VM_OP_JUMPNZ                            14      // Jump to arg if the last command failed
+#define VM_OP_LOOP                              15      // Jump to arg unless the last command was killed
+
+#define VM_OP_COUNT                             16
+
+/* Flags of VM_OP_REDIRECT, besides the fd */
+#define VM_REDIRECT_APPEND                      0x10    // Append to the file instead of truncating it
+
+/* Flags of VM_OP_JUMPNZ */
+#define VM_JUMP_SIGNALLED                       0x01    // Also jump if the last command was killed
+
+/**** TYPES ****/
+
+typedef struct vm_instruction {
+    uint8_t op;                         // Opcode
+    uint8_t reg;                        // Register
+    uint16_t flags;                     // Expansion, exec, fd or jump flags
+    uint32_t arg;                       // Pool offset, jump target or line
+} vm_instruction_t;
+
+typedef struct vm_header {
+    char magic[4];                      // VM_MAGIC
+    uint32_t version;                   // VM_VERSION
+    uint32_t code_count;                // Number of instructions following the header
+    uint32_t pool_size;                 // Size of the string pool following the instructions
+} vm_header_t;
+
+typedef struct vm_program {
+    const vm_instruction_t *code;       // Instructions
+    size_t code_count;                  // Number of instructions
+    const char *pool;                   // String pool
+    size_t pool_size;                   // Size of the string pool
+} vm_program_t;
+
+/**** FUNCTIONS ****/
+
+int vm_isProgram(const char *data, size_t length);
+int vm_load(const char *name, const char *data, size_t length, vm_program_t *program);
+int vm_run(const vm_program_t *program);
+
+#endif
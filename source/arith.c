@@ -0,0 +1,360 @@
+/**
+ * @file arith.c
+ * @brief Shell arithmetic
+ *
+ * Recursive descent evaluator for $((...)) and integer variables. Operators
+ * and precedence follow C, plus ** for exponentiation.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Operators, longest first so the first match is the longest */
+static const char *arith_operators[] = {
+    "<<=", ">>=",
+    "**", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "++", "--",
+    "+=", "-=", "*=", "/=", "%=", "&=", "^=", "|=",
+    "+", "-", "*", "/", "%", "<", ">", "&", "^", "|", "!", "~", "=", "?", ":", "(", ")",
+};
+
+static long long arith_assignment(arith_t *a);
+
+/**
+ * @brief Report an error (only the first one is printed)
+ */
+static void arith_error(arith_t *a, const char *msg) {
+    if (a->error) return;
+    a->error = 1;
+
+    if (*a->p) fprintf(stderr, "essence: %s: %s (error token is \"%s\")\n", a->expr, msg, a->p);
+    else fprintf(stderr, "essence: %s: %s\n", a->expr, msg);
+}
+
+/**
+ * @brief Get the operator at the current position without consuming it
+ * @returns The operator, or NULL
+ */
+static const char *arith_peek(arith_t *a) {
+    while (isspace((unsigned char)*a->p)) a->p++;
+
+    for (size_t i = 0; i < sizeof(arith_operators) / sizeof(*arith_operators); i++) {
+        size_t len = strlen(arith_operators[i]);
+        if (!strncmp(a->p, arith_operators[i], len)) return arith_operators[i];
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Consume an operator if it is next
+ */
+static int arith_accept(arith_t *a, const char *op) {
+    const char *next = arith_peek(a);
+    if (!next || strcmp(next, op)) return 0;
+
+    a->p += strlen(op);
+    return 1;
+}
+
+/**
+ * @brief Read an identifier
+ * @returns Length of the identifier, or 0
+ */
+static size_t arith_name(arith_t *a, char *name, size_t namesz) {
+    while (isspace((unsigned char)*a->p)) a->p++;
+    if (!isalpha((unsigned char)*a->p) && *a->p != '_') return 0;
+
+    size_t len = 0;
+    while (isalnum((unsigned char)a->p[len]) || a->p[len] == '_') len++;
+    if (len >= namesz) {
+        arith_error(a, "variable name too long");
+        return 0;
+    }
+
+    memcpy(name, a->p, len);
+    name[len] = 0;
+    a->p += len;
+    return len;
+}
+
+/**
+ * @brief Get the numeric value of a variable
+ */
+static long long arith_variable(arith_t *a, const char *name) {
+    const char *value = variable_get(name);
+    if (!value || !*value) return 0;
+
+    char *end;
+    long long n = strtoll(value, &end, 0);
+    if (!*end) return n;
+
+    // Not a plain number, evaluate it as an expression
+    if (a->depth >= ARITH_MAX_DEPTH) {
+        arith_error(a, "expression recursion level exceeded");
+        return 0;
+    }
+
+    arith_t sub = { .expr = (char*)value, .p = (char*)value, .error = 0, .noeval = a->noeval, .depth = a->depth + 1 };
+    n = arith_assignment(&sub);
+    while (isspace((unsigned char)*sub.p)) sub.p++;
+    if (!sub.error && *sub.p) arith_error(&sub, "syntax error in expression");
+    if (sub.error) a->error = 1;
+    return n;
+}
+
+/**
+ * @brief Assign a variable
+ */
+static void arith_store(arith_t *a, const char *name, long long value) {
+    if (a->noeval || a->error) return;
+
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "%lld", value);
+    if (variable_set(name, tmp) < 0) a->error = 1;
+}
+
+/**
+ * @brief Apply a binary operator
+ */
+static long long arith_apply(arith_t *a, const char *op, long long lhs, long long rhs) {
+    switch (op[0]) {
+        case '+': return lhs + rhs;
+        case '-': return lhs - rhs;
+        case '^': return lhs ^ rhs;
+        case '=': return lhs == rhs;
+        case '!': return lhs != rhs;
+        case '&': return (op[1] == '&') ? (lhs && rhs) : (lhs & rhs);
+        case '|': return (op[1] == '|') ? (lhs || rhs) : (lhs | rhs);
+
+        case '<':
+            if (op[1] == '<') return lhs << rhs;
+            return (op[1] == '=') ? (lhs <= rhs) : (lhs < rhs);
+
+        case '>':
+            if (op[1] == '>') return lhs >> rhs;
+            return (op[1] == '=') ? (lhs >= rhs) : (lhs > rhs);
+
+        case '*':
+            if (op[1] == '*') {
+                if (rhs < 0) {
+                    arith_error(a, "exponent less than 0");
+                    return 0;
+                }
+
+                long long r = 1;
+                while (rhs--) r *= lhs;
+                return r;
+            }
+            return lhs * rhs;
+
+        case '/':
+        case '%':
+            if (!rhs) {
+                if (!a->noeval) arith_error(a, "division by 0");
+                return 0;
+            }
+            return (op[0] == '/') ? lhs / rhs : lhs % rhs;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the precedence of a binary operator
+ * @returns Precedence, or 0 if it is not a binary operator
+ */
+static int arith_precedence(const char *op) {
+    static const struct { const char *op; int prec; } table[] = {
+        { "||", 1 }, { "&&", 2 }, { "|", 3 }, { "^", 4 }, { "&", 5 },
+        { "==", 6 }, { "!=", 6 },
+        { "<", 7 }, { "<=", 7 }, { ">", 7 }, { ">=", 7 },
+        { "<<", 8 }, { ">>", 8 },
+        { "+", 9 }, { "-", 9 },
+        { "*", 10 }, { "/", 10 }, { "%", 10 },
+        { "**", 11 },
+    };
+
+    if (!op) return 0;
+    for (size_t i = 0; i < sizeof(table) / sizeof(*table); i++) {
+        if (!strcmp(table[i].op, op)) return table[i].prec;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Parse a unary expression
+ */
+static long long arith_unary(arith_t *a) {
+    char name[256];
+    const char *op = arith_peek(a);
+
+    if (op && (!strcmp(op, "++") || !strcmp(op, "--"))) {
+        a->p += 2;
+        if (!arith_name(a, name, sizeof(name))) {
+            arith_error(a, "syntax error: operand expected");
+            return 0;
+        }
+
+        long long v = arith_variable(a, name) + ((op[0] == '+') ? 1 : -1);
+        arith_store(a, name, v);
+        return v;
+    }
+
+    if (op && (!strcmp(op, "+") || !strcmp(op, "-") || !strcmp(op, "!") || !strcmp(op, "~"))) {
+        a->p++;
+        long long v = arith_unary(a);
+        switch (op[0]) {
+            case '-': return -v;
+            case '!': return !v;
+            case '~': return ~v;
+            default: return v;
+        }
+    }
+
+    if (op && !strcmp(op, "(")) {
+        a->p++;
+        long long v = arith_assignment(a);
+        if (!arith_accept(a, ")")) arith_error(a, "missing `)'");
+        return v;
+    }
+
+    if (isdigit((unsigned char)*a->p)) {
+        char *end;
+        long long v = strtoll(a->p, &end, 0);
+        if (isalnum((unsigned char)*end) || *end == '_') {
+            arith_error(a, "value too great for base");
+            return 0;
+        }
+
+        a->p = end;
+        return v;
+    }
+
+    if (arith_name(a, name, sizeof(name))) {
+        long long v = arith_variable(a, name);
+
+        op = arith_peek(a);
+        if (op && (!strcmp(op, "++") || !strcmp(op, "--"))) {
+            a->p += 2;
+            arith_store(a, name, v + ((op[0] == '+') ? 1 : -1));
+        }
+
+        return v;
+    }
+
+    arith_error(a, "syntax error: operand expected");
+    return 0;
+}
+
+/**
+ * @brief Parse binary operators with at least the given precedence
+ */
+static long long arith_binary(arith_t *a, int minprec) {
+    long long lhs = arith_unary(a);
+
+    while (!a->error) {
+        const char *op = arith_peek(a);
+        int prec = arith_precedence(op);
+        if (!prec || prec < minprec) break;
+        a->p += strlen(op);
+
+        // Short-circuit the right side of && and ||
+        int skip = (!strcmp(op, "&&") && !lhs) || (!strcmp(op, "||") && lhs);
+        if (skip) a->noeval++;
+
+        // ** is right associative
+        long long rhs = arith_binary(a, (prec == 11) ? prec : prec + 1);
+        if (skip) a->noeval--;
+
+        lhs = arith_apply(a, op, lhs, rhs);
+    }
+
+    return lhs;
+}
+
+/**
+ * @brief Parse a conditional expression
+ */
+static long long arith_ternary(arith_t *a) {
+    long long cond = arith_binary(a, 1);
+    if (a->error || !arith_accept(a, "?")) return cond;
+
+    if (!cond) a->noeval++;
+    long long t = arith_assignment(a);
+    if (!cond) a->noeval--;
+
+    if (!arith_accept(a, ":")) {
+        arith_error(a, "`:' expected for conditional expression");
+        return 0;
+    }
+
+    if (cond) a->noeval++;
+    long long f = arith_ternary(a);
+    if (cond) a->noeval--;
+
+    return cond ? t : f;
+}
+
+/**
+ * @brief Parse an assignment expression
+ */
+static long long arith_assignment(arith_t *a) {
+    char name[256];
+    char *start = a->p;
+
+    if (arith_name(a, name, sizeof(name))) {
+        const char *op = arith_peek(a);
+        size_t oplen = op ? strlen(op) : 0;
+
+        if (op && op[oplen - 1] == '=' && strcmp(op, "==") && strcmp(op, "<=") && strcmp(op, ">=") && strcmp(op, "!=")) {
+            a->p += oplen;
+            long long rhs = arith_assignment(a);
+
+            if (oplen > 1) {
+                // Compound assignment, apply the operator without its '='
+                char binop[3] = { 0 };
+                memcpy(binop, op, oplen - 1);
+                rhs = arith_apply(a, binop, arith_variable(a, name), rhs);
+            }
+
+            arith_store(a, name, rhs);
+            return rhs;
+        }
+    }
+
+    a->p = start;
+    return arith_ternary(a);
+}
+
+/**
+ * @brief Evaluate an arithmetic expression
+ * @param expr The expression (after parameter expansion)
+ * @param result Output result
+ * @returns 0 on success, -1 on error (which has already been reported)
+ */
+int arith_evaluate(char *expr, long long *result) {
+    arith_t a = { .expr = expr, .p = expr, .error = 0, .noeval = 0, .depth = 0 };
+
+    *result = 0;
+    while (isspace((unsigned char)*a.p)) a.p++;
+    if (!*a.p) return 0;
+
+    long long v = arith_assignment(&a);
+    while (isspace((unsigned char)*a.p)) a.p++;
+    if (!a.error && *a.p) arith_error(&a, "syntax error in expression");
+    if (a.error) return -1;
+
+    *result = v;
+    return 0;
+}
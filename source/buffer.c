@@ -13,6 +13,7 @@
 
 #include "essence.h"
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * @brief Create a new buffer
@@ -54,6 +55,22 @@ void buffer_pushString(buffer_t *buf, char *str) {
     while (*p) buffer_push(buf, *p++);
 }
 
+/**
+ * @brief Append bytes to buffer
+ * @param buf The buffer to append to
+ * @param data The bytes
+ * @param length Number of bytes
+ */
+void buffer_append(buffer_t *buf, const char *data, size_t length) {
+    if (buf->bufidx + length >= buf->bufsz) {
+        while (buf->bufidx + length >= buf->bufsz) buf->bufsz *= 2;
+        buf->buffer = realloc(buf->buffer, buf->bufsz);
+    }
+
+    memcpy(buf->buffer + buf->bufidx, data, length);
+    buf->bufidx += length;
+    buf->buffer[buf->bufidx] = 0;
+}
 
 /**
  * @brief Pop from buffer
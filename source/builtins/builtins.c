@@ -20,6 +20,13 @@ extern int if_cond(int argc, char *argv[]);
 extern int then_cond(int argc, char *argv[]);
 extern int fi_cond(int argc, char *argv[]);
 extern int export(int argc, char *argv[]);
+extern int shopt(int argc, char *argv[]);
+extern int declare(int argc, char *argv[]);
+extern int readonly_builtin(int argc, char *argv[]);
+extern int unset(int argc, char *argv[]);
+extern int source(int argc, char *argv[]);
+extern int complete_builtin(int argc, char *argv[]);
+extern int history_builtin(int argc, char *argv[]);
 
 
 int help(int argc, char *argv[]);
@@ -29,7 +36,16 @@ builtin_t builtin_list[] = {
     { .name = "pwd", .usage = "pwd", .func = pwd },
     { .name = "help", .usage = "help", .func = help },
     { .name = "exit", .usage = "exit [n]", .func = exit_builtin },
-    { .name = "export", .usage = "export [var]=[value]", .func = export}
+    { .name = "export", .usage = "export [var]=[value]", .func = export},
+    { .name = "shopt", .usage = "shopt [-s|-u] [optname ...]", .func = shopt },
+    { .name = "declare", .usage = "declare [-aAirxp] [name[=value] ...]", .func = declare },
+    { .name = "typeset", .usage = "typeset [-aAirxp] [name[=value] ...]", .func = declare },
+    { .name = "readonly", .usage = "readonly [name[=value] ...]", .func = readonly_builtin },
+    { .name = "unset", .usage = "unset [name ...]", .func = unset },
+    { .name = "source", .usage = "source filename [arguments]", .func = source },
+    { .name = ".", .usage = ". filename [arguments]", .func = source },
+    { .name = "complete", .usage = "complete [-fdpr] [-W words] [-C command] [-t seconds] [-X filter] [name ...]", .func = complete_builtin },
+    { .name = "history", .usage = "history [-c] [n]", .func = history_builtin },
 };
 
 const int builtin_list_size = sizeof(builtin_list) / sizeof(builtin_t);
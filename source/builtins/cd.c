@@ -16,14 +16,17 @@
 #include <errno.h>
 
 int cd(int argc, char *argv[]) {
-    char *dir = getenv("HOME");
+    const char *dir = variable_get("HOME");
     if (argc > 1) dir = argv[1];
     if (!dir) return 0;
 
-    if (chdir(argv[1]) < 0) {
+    if (chdir(dir) < 0) {
         fprintf(stderr, "essence: %s: %s\n", dir, strerror(errno));
         return 1;
     }
 
+    // The prompt keeps the working directory instead of asking for it every time
+    prompt_setCwd();
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,135 @@
+/**
+ * @file builtins/complete.c
+ * @brief complete command
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Print a string single-quoted
+ */
+static void complete_printQuoted(const char *str) {
+    putchar('\'');
+    for (; *str; str++) {
+        if (*str == '\'') fputs("'\\''", stdout);
+        else putchar(*str);
+    }
+    putchar('\'');
+}
+
+/**
+ * @brief Print a spec as the complete command that makes it
+ */
+static void complete_printSpec(complete_spec_t *spec) {
+    fputs("complete", stdout);
+    if (spec->flags & COMPLETE_SPEC_FILES) fputs(" -f", stdout);
+    if (spec->flags & COMPLETE_SPEC_DIRS) fputs(" -d", stdout);
+    if (spec->wordlist) { fputs(" -W ", stdout); complete_printQuoted(spec->wordlist); }
+    if (spec->command) { fputs(" -C ", stdout); complete_printQuoted(spec->command); }
+    if (spec->ttl) printf(" -t %d", spec->ttl);
+    if (spec->filter) { fputs(" -X ", stdout); complete_printQuoted(spec->filter); }
+    printf(" %s\n", spec->name);
+}
+
+int complete_builtin(int argc, char *argv[]) {
+    int flags = 0;
+    int print = 0;
+    int remove = 0;
+    int ttl = 0;
+    char *wordlist = NULL;
+    char *command = NULL;
+    char *filter = NULL;
+
+    int i;
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        if (!strcmp(argv[i], "--")) { i++; break; }
+
+        for (char *opt = argv[i] + 1; *opt; opt++) {
+            switch (*opt) {
+                case 'f': flags |= COMPLETE_SPEC_FILES; continue;
+                case 'd': flags |= COMPLETE_SPEC_DIRS; continue;
+                case 'p': print = 1; continue;
+                case 'r': remove = 1; continue;
+                case 'W': case 'C': case 't': case 'X': break;
+                default:
+                    fprintf(stderr, "essence: complete: -%c: invalid option\n", *opt);
+                    return 2;
+            }
+
+            // The rest of the argument or the next one is the value
+            char *value = opt[1] ? opt + 1 : argv[++i];
+            if (!value) {
+                fprintf(stderr, "essence: complete: -%c: option requires an argument\n", *opt);
+                return 2;
+            }
+
+            if (*opt == 'W') wordlist = value;
+            else if (*opt == 'C') command = value;
+            else if (*opt == 'X') filter = value;
+            else {
+                char *end;
+                ttl = strtol(value, &end, 10);
+                if (*end || ttl < 0) {
+                    fprintf(stderr, "essence: complete: %s: invalid number of seconds\n", value);
+                    return 1;
+                }
+            }
+
+            break;
+        }
+    }
+
+    if (remove) {
+        if (i >= argc) return complete_removeSpec(NULL);
+
+        int ret = 0;
+        for (; i < argc; i++) {
+            if (complete_removeSpec(argv[i]) < 0) {
+                fprintf(stderr, "essence: complete: %s: no completion specification\n", argv[i]);
+                ret = 1;
+            }
+        }
+
+        return ret;
+    }
+
+    // No names, print everything
+    if (i >= argc) {
+        for (complete_spec_t *spec = complete_listSpecs(); spec; spec = spec->next) complete_printSpec(spec);
+        return 0;
+    }
+
+    if (print) {
+        int ret = 0;
+        for (; i < argc; i++) {
+            complete_spec_t *spec;
+            for (spec = complete_listSpecs(); spec; spec = spec->next) {
+                if (!strcmp(spec->name, argv[i])) break;
+            }
+
+            if (!spec) {
+                fprintf(stderr, "essence: complete: %s: no completion specification\n", argv[i]);
+                ret = 1;
+                continue;
+            }
+
+            complete_printSpec(spec);
+        }
+
+        return ret;
+    }
+
+    for (; i < argc; i++) complete_setSpec(argv[i], flags, wordlist, command, ttl, filter);
+    return 0;
+}
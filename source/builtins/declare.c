@@ -0,0 +1,206 @@
+/**
+ * @file builtins/declare.c
+ * @brief declare and readonly commands
+ * 
+ * 
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ * 
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * @brief Print a double-quoted value
+ */
+static void declare_printValue(const char *value) {
+    putchar('"');
+    for (const char *p = value; *p; p++) {
+        if (strchr("\"\\$`", *p)) putchar('\\');
+        putchar(*p);
+    }
+    putchar('"');
+}
+
+/**
+ * @brief Print a variable in a form that can be read back
+ */
+static void declare_print(variable_t *v) {
+    char attrs[8];
+    int n = 0;
+
+    if (v->type == VARIABLE_TYPE_INDEXED) attrs[n++] = 'a';
+    if (v->type == VARIABLE_TYPE_ASSOC) attrs[n++] = 'A';
+
+    if (v->flags & VARIABLE_FLAG_INTEGER) attrs[n++] = 'i';
+    if (v->flags & VARIABLE_FLAG_READONLY) attrs[n++] = 'r';
+    if (v->flags & VARIABLE_FLAG_EXPORT) attrs[n++] = 'x';
+    if (!n) attrs[n++] = '-';
+    attrs[n] = 0;
+
+    if (v->array) {
+        printf("declare -%s %s=(", attrs, v->name);
+
+        size_t cursor = 0;
+        variable_element_t *e;
+        while ((e = variable_iterate(v, &cursor))) {
+            if (e->key) printf("[%s]=", e->key);
+            else printf("[%lld]=", e->index);
+            declare_printValue(e->value);
+            putchar(' ');
+        }
+
+        printf(")\n");
+        return;
+    }
+
+    if (!v->value) {
+        printf("declare -%s %s\n", attrs, v->name);
+        return;
+    }
+
+    printf("declare -%s %s=", attrs, v->name);
+    declare_printValue(v->value);
+    putchar('\n');
+}
+
+/**
+ * @brief Parse attribute options
+ * @returns 0 on success, -1 if an option is invalid
+ */
+static int declare_parseFlags(char *arg, int *set, int *clear, int *type, int *print) {
+    int *target = (*arg == '-') ? set : clear;
+
+    for (char *p = arg + 1; *p; p++) {
+        switch (*p) {
+            case 'a': *type = VARIABLE_TYPE_INDEXED; break;
+            case 'A': *type = VARIABLE_TYPE_ASSOC; break;
+            case 'i': *target |= VARIABLE_FLAG_INTEGER; break;
+            case 'r': *target |= VARIABLE_FLAG_READONLY; break;
+            case 'x': *target |= VARIABLE_FLAG_EXPORT; break;
+            case 'p': *print = 1; break;
+            default:
+                fprintf(stderr, "essence: declare: %c%c: invalid option\n", *arg, *p);
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Assign a value, which is a list if it is wrapped in parentheses
+ */
+static int declare_assign(char *name, char *value) {
+    size_t len = strlen(value);
+    if (len < 2 || *value != '(' || value[len - 1] != ')') return variable_set(name, value);
+
+    variable_t *v = variable_find(name);
+    int type = (v && v->type == VARIABLE_TYPE_ASSOC) ? VARIABLE_TYPE_ASSOC : VARIABLE_TYPE_INDEXED;
+    if (v && (v->flags & VARIABLE_FLAG_READONLY)) {
+        fprintf(stderr, "essence: %s: readonly variable\n", name);
+        return -1;
+    }
+
+    if (!(v = variable_declareArray(name, type))) return -1;
+    variable_clearArray(v);
+
+    value[len - 1] = 0;
+    int ret = expand_compoundAssign(v, value + 1);
+    value[len - 1] = ')';
+    return ret;
+}
+
+/**
+ * @brief Apply attributes and an optional value to one name
+ */
+static int declare_apply(char *arg, int set, int clear, int type) {
+    char *eq = strchr(arg, '=');
+    if (eq) *eq = 0;
+
+    if (!*arg || expand_nameLength(arg) != strlen(arg) || !(isalpha((unsigned char)*arg) || *arg == '_')) {
+        fprintf(stderr, "essence: declare: `%s': not a valid identifier\n", arg);
+        if (eq) *eq = '=';
+        return 1;
+    }
+
+    // Readonly is applied last so "declare -r x=1" can still assign
+    int ret = 0;
+    if (variable_setFlags(arg, set & ~VARIABLE_FLAG_READONLY, clear) < 0) ret = 1;
+    else if (type && !variable_declareArray(arg, type)) ret = 1;
+    else if (eq && declare_assign(arg, eq + 1) < 0) ret = 1;
+    else if (variable_setFlags(arg, set & VARIABLE_FLAG_READONLY, 0) < 0) ret = 1;
+
+    if (eq) *eq = '=';
+    return ret;
+}
+
+/**
+ * @brief Print every variable with all of the given attributes
+ */
+static void declare_printAll(int flags) {
+    size_t count;
+    variable_t **list = variable_list(&count);
+
+    for (size_t i = 0; i < count; i++) {
+        if ((list[i]->flags & flags) != flags) continue;
+        if (!list[i]->value && !list[i]->array && !list[i]->flags) continue;
+        declare_print(list[i]);
+    }
+
+    free(list);
+}
+
+int declare(int argc, char *argv[]) {
+    int set = 0, clear = 0, type = 0, print = 0;
+    int i = 1;
+
+    for (; i < argc && (*argv[i] == '-' || *argv[i] == '+') && argv[i][1]; i++) {
+        if (!strcmp(argv[i], "--")) { i++; break; }
+        if (declare_parseFlags(argv[i], &set, &clear, &type, &print) < 0) return 2;
+    }
+
+    if (i >= argc) {
+        declare_printAll(set);
+        return 0;
+    }
+
+    int ret = 0;
+    for (; i < argc; i++) {
+        if (print) {
+            variable_t *v = variable_find(argv[i]);
+            if (!v || (!v->value && !v->array && !v->flags)) {
+                fprintf(stderr, "essence: declare: %s: not found\n", argv[i]);
+                ret = 1;
+                continue;
+            }
+
+            declare_print(v);
+            continue;
+        }
+
+        ret |= declare_apply(argv[i], set, clear, type);
+    }
+
+    return ret;
+}
+
+int readonly_builtin(int argc, char *argv[]) {
+    int i = 1;
+    if (i < argc && !strcmp(argv[i], "-p")) i++;
+
+    if (i >= argc) {
+        declare_printAll(VARIABLE_FLAG_READONLY);
+        return 0;
+    }
+
+    int ret = 0;
+    for (; i < argc; i++) ret |= declare_apply(argv[i], VARIABLE_FLAG_READONLY, 0, 0);
+    return ret;
+}
@@ -11,24 +11,45 @@
  * Copyright (C) 2025 Samuel Stuart
  */
 
+#include "essence.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-extern char **environ;
-
 int export(int argc, char *argv[]) {
-    if (argc == 1) {
-        char **e = environ;
-        while (*e) {
-            printf("%s\n", *e);
-            e++;
+    int i = 1;
+    int unexport = 0;
+
+    if (i < argc && !strcmp(argv[i], "-n")) { unexport = 1; i++; }
+    else if (i < argc && !strcmp(argv[i], "-p")) i++;
+
+    if (i >= argc) {
+        size_t count;
+        variable_t **list = variable_list(&count);
+
+        for (size_t v = 0; v < count; v++) {
+            if (!(list[v]->flags & VARIABLE_FLAG_EXPORT) || !list[v]->value) continue;
+            printf("%s=%s\n", list[v]->name, list[v]->value);
         }
-    } else {
-        for (int i = 1; i < argc; i++) {
-            putenv(strdup(argv[i])); // Stupid putenv... the strdup is required.
+
+        free(list);
+        return 0;
+    }
+
+    int ret = 0;
+    for (; i < argc; i++) {
+        char *eq = strchr(argv[i], '=');
+        if (eq) *eq = 0;
+
+        if (unexport) {
+            if (variable_setFlags(argv[i], 0, VARIABLE_FLAG_EXPORT) < 0) ret = 1;
+        } else {
+            if (variable_setFlags(argv[i], VARIABLE_FLAG_EXPORT, 0) < 0) ret = 1;
+            else if (eq && variable_set(argv[i], eq + 1) < 0) ret = 1;
         }
+
+        if (eq) *eq = '=';
     }
 
-    return 0;
-}
\ No newline at end of file
+    return ret;
+}
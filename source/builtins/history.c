@@ -0,0 +1,63 @@
+/**
+ * @file builtins/history.c
+ * @brief history command
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int history_builtin(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "-c")) {
+        history_clear();
+        return 0;
+    }
+
+    if (argc > 2) {
+        fprintf(stderr, "essence: history: too many arguments\n");
+        return 1;
+    }
+
+    size_t count = history_count();
+    size_t first = 0;
+
+    // Only the last n
+    if (argc > 1) {
+        char *end;
+        long n = strtol(argv[1], &end, 10);
+        if (!*argv[1] || *end || n < 0) {
+            fprintf(stderr, "essence: history: %s: numeric argument required\n", argv[1]);
+            return 1;
+        }
+
+        if ((size_t)n < count) first = count - n;
+    }
+
+    const char *format = variable_get("HISTTIMEFORMAT");
+
+    for (size_t i = first; i < count; i++) {
+        history_entry_t *entry = history_entry(i);
+        printf("%5zu  ", i + 1);
+
+        if (format && *format && entry->time) {
+            char stamp[256];
+            struct tm tm;
+            localtime_r(&entry->time, &tm);
+            if (strftime(stamp, sizeof(stamp), format, &tm)) fputs(stamp, stdout);
+        }
+
+        printf("%s\n", entry->line);
+    }
+
+    return 0;
+}
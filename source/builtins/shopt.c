@@ -0,0 +1,69 @@
+/**
+ * @file builtins/shopt.c
+ * @brief shopt command
+ * 
+ * 
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ * 
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <string.h>
+
+static struct {
+    char *name;
+    int flag;
+} shopt_list[] = {
+    { .name = "dotglob", .flag = ESSENCE_OPTION_DOTGLOB },
+    { .name = "fuzzycomplete", .flag = ESSENCE_OPTION_FUZZY },
+    { .name = "globstar", .flag = ESSENCE_OPTION_GLOBSTAR },
+    { .name = "nullglob", .flag = ESSENCE_OPTION_NULLGLOB },
+};
+
+#define SHOPT_COUNT (int)(sizeof(shopt_list) / sizeof(*shopt_list))
+
+int shopt(int argc, char *argv[]) {
+    int set = -1;
+    int i = 1;
+
+    if (argc > 1 && !strcmp(argv[1], "-s")) { set = 1; i++; }
+    else if (argc > 1 && !strcmp(argv[1], "-u")) { set = 0; i++; }
+
+    // No names, print everything
+    if (i >= argc) {
+        for (int o = 0; o < SHOPT_COUNT; o++) {
+            if (set != -1 && !!(essence_options & shopt_list[o].flag) != set) continue;
+            printf("%-16s%s\n", shopt_list[o].name, (essence_options & shopt_list[o].flag) ? "on" : "off");
+        }
+
+        return 0;
+    }
+
+    int ret = 0;
+    for (; i < argc; i++) {
+        int o;
+        for (o = 0; o < SHOPT_COUNT; o++) {
+            if (!strcmp(shopt_list[o].name, argv[i])) break;
+        }
+
+        if (o == SHOPT_COUNT) {
+            fprintf(stderr, "essence: shopt: %s: invalid shell option name\n", argv[i]);
+            ret = 1;
+            continue;
+        }
+
+        if (set == 1) essence_options |= shopt_list[o].flag;
+        else if (set == 0) essence_options &= ~shopt_list[o].flag;
+        else {
+            printf("%-16s%s\n", shopt_list[o].name, (essence_options & shopt_list[o].flag) ? "on" : "off");
+            if (!(essence_options & shopt_list[o].flag)) ret = 1;
+        }
+    }
+
+    return ret;
+}
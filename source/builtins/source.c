@@ -0,0 +1,97 @@
+/**
+ * @file builtins/source.c
+ * @brief source and . commands
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Find a script to source, a name without a slash is looked up in PATH first
+ * @returns The path (static storage) or @c name itself
+ */
+static char *source_find(char *name) {
+    static char path[PATH_MAX];
+
+    const char *dirs = variable_get("PATH");
+    if (strchr(name, '/') || !dirs) return name;
+
+    while (*dirs) {
+        const char *end = strchr(dirs, ':');
+        size_t len = end ? (size_t)(end - dirs) : strlen(dirs);
+
+        if (len && snprintf(path, sizeof(path), "%.*s/%s", (int)len, dirs, name) < (int)sizeof(path)) {
+            struct stat st;
+            if (!stat(path, &st) && S_ISREG(st.st_mode) && !access(path, R_OK)) return path;
+        }
+
+        if (!end) break;
+        dirs = end + 1;
+    }
+
+    return name;
+}
+
+int source(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "essence: %s: filename argument required\n", argv[0]);
+        return 2;
+    }
+
+    char *path = source_find(argv[1]);
+
+    // The caller may be in the middle of a line, put it aside
+    input_state_t state;
+    input_save(&state);
+
+    compile_cache_t *entry = compile_cached(path);
+    if (!entry) {
+        input_restore(&state);
+        return 1;
+    }
+
+    // Extra arguments replace the positional parameters while it runs
+    int saved_argc = essence_argc;
+    char **saved_argv = essence_argv;
+    char **args = NULL;
+
+    if (argc > 2) {
+        args = malloc(argc * sizeof(char*));
+        args[0] = essence_argv[0];
+        memcpy(&args[1], &argv[2], (argc - 1) * sizeof(char*));
+        essence_argc = argc - 1;
+        essence_argv = args;
+    }
+
+    if (entry->interpret) {
+        // Like running it as a script, the lines around a syntax error still run
+        essence_runScript(path);
+    } else {
+        // Only used for the name and line in error messages
+        input_loadString(argv[1], "");
+
+        entry->running++;
+        vm_run(&entry->program);
+        compile_release(entry);
+    }
+
+    essence_argc = saved_argc;
+    essence_argv = saved_argv;
+    free(args);
+
+    input_restore(&state);
+    return cmd_last_exit_status;
+}
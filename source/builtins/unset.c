@@ -0,0 +1,44 @@
+/**
+ * @file builtins/unset.c
+ * @brief unset command
+ * 
+ * 
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ * 
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <string.h>
+
+int unset(int argc, char *argv[]) {
+    int i = 1;
+    if (i < argc && !strcmp(argv[i], "-v")) i++;
+
+    int ret = 0;
+    for (; i < argc; i++) {
+        char *bracket = strchr(argv[i], '[');
+        size_t len = strlen(argv[i]);
+
+        if (!bracket || argv[i][len - 1] != ']') {
+            if (variable_unset(argv[i]) < 0) ret = 1;
+            continue;
+        }
+
+        // name[subscript] unsets one element
+        *bracket = 0;
+        argv[i][len - 1] = 0;
+
+        variable_t *v = variable_find(argv[i]);
+        if (v && variable_unsetElement(v, bracket + 1) < 0) ret = 1;
+
+        *bracket = '[';
+        argv[i][len - 1] = ']';
+    }
+
+    return ret;
+}
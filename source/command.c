@@ -21,7 +21,9 @@
 #include <errno.h>
 #include <signal.h>
 #include <termios.h>
+#include <fcntl.h>
 
+extern char **environ;
 
 
 /* Last command exit status */
@@ -29,6 +31,9 @@ int cmd_last_exit_status = 0;
 int cmd_waitpid_exit_status = 0;
 int cmd_last_signalled = 0;
 
+/* Commands get their own process group and the terminal, off where nothing may take the terminal */
+int cmd_job_control = 1;
+
 /**
  * @brief Set signals
  */
@@ -47,12 +52,12 @@ void command_setSignals(int o) {
  */
 int command_execute(command_t *command) {
     if (!command->argc) {
-        // If any environ were specified, we might have to put them
+        // Plain assignments go to the variable store
         if (command->additional_envp) {
             char **env = command->additional_envp;
 
             while (*env) {
-                putenv(strdup(*env));
+                if (variable_assign(*env) < 0) return (cmd_last_exit_status = 1);
                 env++;
             }
         }
@@ -69,6 +74,11 @@ int command_execute(command_t *command) {
         }
     }
 
+    // Only materialize the environment now that something is actually being spawned
+    fflush(stdout);
+    if (command->stdin == -1) input_sync();
+    char **envp = variable_environ();
+
     // Execute the command
     pid_t cpid = fork();
 
@@ -77,11 +87,13 @@ int command_execute(command_t *command) {
         command_setSignals(1);
 
         // We are the child, setup our data
+        environ = envp;
         if (command->additional_envp) {
             char **env = command->additional_envp;
 
             while (*env) {
-                putenv(*env);
+                // Arrays are never exported
+                if (!strchr(*env, VARIABLE_COMPOUND)) putenv(*env);
                 env++;
             }
         }
@@ -108,8 +120,10 @@ int command_execute(command_t *command) {
     }
 
     // set to child
-    setpgid(cpid, cpid);
-    tcsetpgrp(STDIN_FILENO, cpid);
+    if (cmd_job_control) {
+        setpgid(cpid, cpid);
+        tcsetpgrp(STDIN_FILENO, cpid);
+    }
 
     // Wait on the child
     // TODO: Job control
@@ -125,9 +139,11 @@ int command_execute(command_t *command) {
     }
 
     // restore
-    signal(SIGTTOU, SIG_IGN);
-    tcsetpgrp(STDIN_FILENO, getpid());
-    signal(SIGTTOU, SIG_DFL);
+    if (cmd_job_control) {
+        signal(SIGTTOU, SIG_IGN);
+        tcsetpgrp(STDIN_FILENO, getpid());
+        signal(SIGTTOU, SIG_DFL);
+    }
 
     cmd_last_signalled = WIFSIGNALED(wstatus);
     if (cmd_last_signalled) {
@@ -196,6 +212,35 @@ void command_executeList(command_t *command, size_t command_count) {
     }
 }
 
+/**
+ * @brief Redirect one of a command's standard file descriptors to a file
+ * @param command The command
+ * @param fd The file descriptor to redirect (STDIN_FILENO, STDOUT_FILENO or STDERR_FILENO)
+ * @param flags COMMAND_REDIRECT_* flags
+ * @param path The file (quote marks are removed in place)
+ * @returns 0 on success, -1 if the file could not be opened
+ */
+int command_redirect(command_t *command, int fd, int flags, char *path) {
+    expand_removeQuotes(path);
+
+    int mode = O_RDONLY;
+    if (fd != STDIN_FILENO) mode = O_WRONLY | O_CREAT | ((flags & COMMAND_REDIRECT_APPEND) ? O_APPEND : O_TRUNC);
+
+    int f = open(path, mode, S_IWUSR | S_IRUSR);
+    if (f < 0) {
+        fprintf(stderr, "essence: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    switch (fd) {
+        case STDIN_FILENO: command->stdin = f; break;
+        case STDOUT_FILENO: command->stdout = f; break;
+        case STDERR_FILENO: command->stderr = f; break;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Cleanup and free command resources
  * @param command The command to cleanup
@@ -0,0 +1,909 @@
+/**
+ * @file compile.c
+ * @brief Script compiler
+ *
+ * Compiles a script to bytecode for vm.c. This is the shell's only grammar:
+ * the interpreter compiles each line and runs it on the VM as well, so a
+ * script means the same thing run, sourced, compiled or checked with -n.
+ * Instead of expanding words as they are read, every expansion becomes an
+ * instruction that is run each time the word is needed. Each source line
+ * that emits code is recorded so errors still point at the source.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+/* Next token */
+#define NEXT_TOKEN() goto _next_token
+
+/* Scripts compiled for source, newest first */
+static compile_cache_t *compile_cache = NULL;
+
+static int compile_list(compile_t *c, const char *stop1, const char *stop2);
+
+/**
+ * @brief Emit an instruction
+ * @returns The index of the instruction
+ */
+static size_t compile_emit(compile_t *c, int op, int reg, int flags, uint32_t arg) {
+    // Record the source line of everything that follows
+    int line = input_getLine();
+    if (op != VM_OP_LINE && op != VM_OP_END && line != c->line) {
+        c->line = line;
+        compile_emit(c, VM_OP_LINE, 0, 0, line);
+    }
+
+    if (c->code_count == c->code_size) {
+        c->code_size = c->code_size ? c->code_size * 2 : 256;
+        c->code = realloc(c->code, c->code_size * sizeof(vm_instruction_t));
+    }
+
+    vm_instruction_t *in = &c->code[c->code_count];
+    in->op = op;
+    in->reg = reg;
+    in->flags = flags;
+    in->arg = arg;
+
+    // Everything from VM_OP_LITERAL to VM_OP_COMMAND builds the command list
+    if (op >= VM_OP_LITERAL && op <= VM_OP_COMMAND) c->pending = 1;
+    return c->code_count++;
+}
+
+/**
+ * @brief Mark the next instruction as a jump target
+ * @returns Its index
+ */
+static uint32_t compile_label(compile_t *c) {
+    // The line is unknown when arriving by a jump, so it is always recorded
+    c->line = -1;
+    return c->code_count;
+}
+
+/**
+ * @brief Hash a string (FNV-1a)
+ */
+static unsigned int compile_hash(const char *str) {
+    unsigned int hash = 2166136261u;
+    while (*str) {
+        hash ^= (unsigned char)*str++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Add a string to the pool, or find it if it is already there
+ * @returns Its offset
+ */
+static uint32_t compile_string(compile_t *c, char *str) {
+    // Nothing will run, don't bother keeping it
+    if (c->check) return 0;
+
+    if ((c->string_count + 1) * 10 >= c->strings_size * 7) {
+        // Grow and rehash
+        size_t old_size = c->strings_size;
+        uint32_t *old = c->strings;
+
+        c->strings_size = old_size ? old_size * 2 : COMPILE_INITIAL_STRINGS_SIZE;
+        c->strings = calloc(c->strings_size, sizeof(uint32_t));
+
+        for (size_t i = 0; i < old_size; i++) {
+            if (!old[i]) continue;
+            size_t slot = compile_hash(c->pool->buffer + old[i] - 1) & (c->strings_size - 1);
+            while (c->strings[slot]) slot = (slot + 1) & (c->strings_size - 1);
+            c->strings[slot] = old[i];
+        }
+
+        free(old);
+    }
+
+    size_t slot = compile_hash(str) & (c->strings_size - 1);
+    while (c->strings[slot]) {
+        if (!strcmp(c->pool->buffer + c->strings[slot] - 1, str)) return c->strings[slot] - 1;
+        slot = (slot + 1) & (c->strings_size - 1);
+    }
+
+    uint32_t offset = c->pool->bufidx;
+    buffer_pushString(c->pool, str);
+    buffer_push(c->pool, 0);
+
+    c->strings[slot] = offset + 1;
+    c->string_count++;
+    return offset;
+}
+
+/**
+ * @brief Emit the literal text collected so far
+ */
+static void compile_flush(compile_t *c) {
+    if (!c->literal->bufidx) return;
+
+    compile_emit(c, VM_OP_LITERAL, c->literal_reg, 0, compile_string(c, c->literal->buffer));
+    c->literal->bufidx = 0;
+    c->literal->buffer[0] = 0;
+}
+
+/**
+ * @brief Append a literal character to a register
+ */
+static void compile_literal(compile_t *c, int reg, int ch) {
+    if (c->literal_reg != reg) compile_flush(c);
+
+    c->literal_reg = reg;
+    buffer_push(c->literal, ch);
+    if (reg == VM_REG_WORD) c->word = 1;
+}
+
+/**
+ * @brief Append a literal character to the word, marking it if it is quoted and special to expansion
+ */
+static void compile_quoted(compile_t *c, int ch) {
+    if (c->quoted && EXPAND_IS_META(ch)) compile_literal(c, VM_REG_WORD, EXPAND_CTLESC);
+    compile_literal(c, VM_REG_WORD, ch);
+}
+
+/**
+ * @brief Append an expansion to a register
+ */
+static void compile_expansion(compile_t *c, int op, int reg, int flags, uint32_t arg) {
+    compile_flush(c);
+    compile_emit(c, op, reg, flags, arg);
+    if (reg == VM_REG_WORD) c->word = 1;
+}
+
+/**
+ * @brief Finish the current word
+ */
+static void compile_word(compile_t *c) {
+    compile_flush(c);
+    compile_emit(c, VM_OP_WORD, VM_REG_WORD, 0, 0);
+    c->argc++;
+    c->word = 0;
+}
+
+/**
+ * @brief Finish a pending redirection, the target is the current word
+ */
+static void compile_redirect(compile_t *c) {
+    compile_flush(c);
+    compile_emit(c, VM_OP_REDIRECT, VM_REG_WORD, c->redirect, 0);
+    c->redirect = -1;
+    c->word = 0;
+}
+
+/**
+ * @brief Start a new command in the list
+ */
+static void compile_command(compile_t *c, int flags) {
+    compile_emit(c, VM_OP_COMMAND, 0, flags, 0);
+    c->argc = 0;
+    c->word = 0;
+    c->compound = 0;
+}
+
+/**
+ * @brief Execute the list built so far, if there is one
+ */
+static void compile_execute(compile_t *c) {
+    if (c->pending) compile_emit(c, VM_OP_EXECUTE, 0, 0, 0);
+
+    c->pending = 0;
+    c->argc = 0;
+    c->word = 0;
+    c->compound = 0;
+}
+
+/**
+ * @brief Report a syntax error
+ */
+static void compile_error(compile_t *c, token_t *tok) {
+    parser_syntaxError(tok);
+    c->error = 1;
+}
+
+/**
+ * @brief Compile a parameter expansion
+ */
+static void compile_dollar(compile_t *c, token_t *tok, int reg, int flags) {
+    int ch = input_getCharacter();
+    if (ch == '{' || ch == '(') {
+        char *body = parser_readBalanced(ch, (ch == '{') ? '}' : ')');
+        if (!body) {
+            c->error = 1;
+            return;
+        }
+
+        compile_expansion(c, (ch == '{') ? VM_OP_PARAMETER : VM_OP_SUBSTITUTE, reg, flags, compile_string(c, body));
+        free(body);
+        return;
+    }
+
+    input_ungetCharacter(ch);
+
+    token_t *next = lexer_getToken(tok);
+    if (!next) {
+        compile_literal(c, reg, '$');
+        return;
+    }
+
+    switch (next->type) {
+        case TOKEN_TYPE_DOLLAR: compile_expansion(c, VM_OP_SPECIAL, reg, flags, '$'); break;
+        case TOKEN_TYPE_HASHTAG: compile_expansion(c, VM_OP_SPECIAL, reg, flags, '#'); break;
+        case TOKEN_TYPE_QUESTION_MARK: compile_expansion(c, VM_OP_SPECIAL, reg, flags, '?'); break;
+        case TOKEN_TYPE_STAR: compile_expansion(c, VM_OP_SPECIAL, reg, flags, '*'); break;
+
+        case TOKEN_TYPE_STRING: {
+            char *name = next->value;
+            size_t len = expand_nameLength(name);
+            if (isdigit((unsigned char)*name)) len = 1;
+
+            if (!len) {
+                compile_literal(c, reg, '$');
+            } else {
+                char saved = name[len];
+                name[len] = 0;
+                compile_expansion(c, VM_OP_VARIABLE, reg, flags, compile_string(c, name));
+                name[len] = saved;
+            }
+
+            // The rest of the token is text, marked the way expand_pushValue would
+            int mark = (flags & EXPAND_FLAG_QUOTED) && !(flags & EXPAND_FLAG_RAW);
+            for (char *p = name + len; *p; p++) {
+                if (mark && EXPAND_IS_META(*p)) compile_literal(c, reg, EXPAND_CTLESC);
+                compile_literal(c, reg, *p);
+            }
+
+            free(next->value);
+            break;
+        }
+
+        default:
+            compile_literal(c, reg, '$');
+            lexer_ungetToken(next);
+            return;
+    }
+
+    free(next);
+}
+
+/**
+ * @brief Compile an assignment, the name is the current word
+ */
+static void compile_assignment(compile_t *c, token_t *tok) {
+    // NAME=(...) is kept raw and expanded when it is assigned
+    char *list = parser_readList();
+    if (list) {
+        compile_literal(c, VM_REG_VALUE, VARIABLE_COMPOUND);
+        for (char *p = list; *p; p++) compile_literal(c, VM_REG_VALUE, *p);
+        free(list);
+        goto _assign;
+    }
+
+    token_t *nxt = lexer_getToken(tok);
+    while (nxt && nxt->type != TOKEN_TYPE_EOF && nxt->type != TOKEN_TYPE_NEWLINE) {
+        if (nxt->type == TOKEN_TYPE_SPACE && !c->quoted) {
+            break;
+        } else if (nxt->type == TOKEN_TYPE_DOUBLE_QUOTE) {
+            if (c->single_quoted) { compile_literal(c, VM_REG_VALUE, '\"'); goto _next_value_token; }
+            c->quoted = !c->quoted;
+        } else if (nxt->type == TOKEN_TYPE_SINGLE_QUOTE) {
+            if (c->quoted && !c->single_quoted) { compile_literal(c, VM_REG_VALUE, '\''); goto _next_value_token; }
+            c->quoted = !c->quoted;
+            c->single_quoted = !c->single_quoted;
+        } else if (nxt->type == TOKEN_TYPE_STRING) {
+            for (char *p = nxt->value; *p; p++) compile_literal(c, VM_REG_VALUE, *p);
+            free(nxt->value);
+        } else if (nxt->type == TOKEN_TYPE_STAR || nxt->type == TOKEN_TYPE_QUESTION_MARK) {
+            compile_literal(c, VM_REG_VALUE, (nxt->type == TOKEN_TYPE_STAR) ? '*' : '?');
+        } else if (nxt->type == TOKEN_TYPE_DOLLAR) {
+            if (c->single_quoted) {
+                compile_literal(c, VM_REG_VALUE, '$');
+                goto _next_value_token;
+            }
+
+            compile_dollar(c, nxt, VM_REG_VALUE, EXPAND_FLAG_RAW);
+        }
+
+    _next_value_token: ;
+        token_t *nxt2 = lexer_getToken(nxt);
+        free(nxt);
+        nxt = nxt2;
+    }
+
+    if (nxt) lexer_ungetToken(nxt);
+
+_assign:
+    compile_flush(c);
+    compile_emit(c, VM_OP_ASSIGN, VM_REG_WORD, 0, 0);
+    c->word = 0;
+}
+
+/**
+ * @brief Compile an if statement, after the "if"
+ */
+static int compile_if(compile_t *c) {
+    if (compile_list(c, "then", NULL) != 1) return -1;
+    size_t jump_else = compile_emit(c, VM_OP_JUMPNZ, 0, 0, 0);
+
+    int stop = compile_list(c, "else", "fi");
+    if (stop < 0) return -1;
+
+    if (stop == 1) {
+        size_t jump_end = compile_emit(c, VM_OP_JUMP, 0, 0, 0);
+        c->code[jump_else].arg = compile_label(c);
+        if (compile_list(c, "fi", NULL) != 1) return -1;
+        c->code[jump_end].arg = compile_label(c);
+    } else {
+        c->code[jump_else].arg = compile_label(c);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Compile a while loop, after the "while"
+ */
+static int compile_while(compile_t *c) {
+    uint32_t top = compile_label(c);
+    if (compile_list(c, "do", NULL) != 1) return -1;
+    size_t jump_end = compile_emit(c, VM_OP_JUMPNZ, 0, VM_JUMP_SIGNALLED, 0);
+
+    if (compile_list(c, "done", NULL) != 1) return -1;
+    compile_emit(c, VM_OP_LOOP, 0, 0, top);
+    c->code[jump_end].arg = compile_label(c);
+    return 0;
+}
+
+/**
+ * @brief Check for a reserved word that can only follow something else
+ */
+static int compile_isReserved(const char *word) {
+    static const char *reserved[] = { "then", "else", "fi", "do", "done" };
+    for (size_t i = 0; i < sizeof(reserved) / sizeof(*reserved); i++) {
+        if (!strcmp(word, reserved[i])) return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Compile commands up to a newline (stop1 == NULL) or a stop word
+ * @returns 0 at a newline, 1 or 2 for the stop word found, -1 on error
+ */
+static int compile_list(compile_t *c, const char *stop1, const char *stop2) {
+    token_t *tok = NULL;
+    int result = -1;
+
+    c->quoted = 0;
+    c->single_quoted = 0;
+    c->redirect = -1;
+
+    while (!c->error) {
+        token_t *new = lexer_getToken(tok);
+        if (tok) free(tok);
+        tok = new;
+
+        if (!tok) {
+            result = 0;
+            break;
+        }
+
+        if (tok->type == TOKEN_TYPE_STRING && !c->quoted && c->redirect < 0 && !c->argc && !c->word) {
+            if ((stop1 && !strcmp(tok->value, stop1)) || (stop2 && !strcmp(tok->value, stop2))) {
+                result = (stop1 && !strcmp(tok->value, stop1)) ? 1 : 2;
+                free(tok->value);
+                compile_execute(c);
+                break;
+            }
+
+            if (!strcmp(tok->value, "if") || !strcmp(tok->value, "while")) {
+                int is_if = (tok->value[0] == 'i');
+                free(tok->value);
+                free(tok);
+                tok = NULL;
+
+                // Whatever came before runs first
+                compile_execute(c);
+                if ((is_if ? compile_if(c) : compile_while(c)) < 0) break;
+
+                c->compound = 1;
+                NEXT_TOKEN();
+            }
+
+            if (compile_isReserved(tok->value)) {
+                parser_error(tok->column, "syntax error near unexpected token `%s'\n", tok->value);
+                free(tok->value);
+                c->error = 1;
+                break;
+            }
+        }
+
+        switch (tok->type) {
+            case TOKEN_TYPE_SPACE:
+                if (!c->word) NEXT_TOKEN();
+
+                if (c->quoted) {
+                    compile_literal(c, VM_REG_WORD, ' ');
+                    NEXT_TOKEN();
+                }
+
+                if (c->redirect >= 0) compile_redirect(c);
+                else compile_word(c);
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_STRING:
+                for (char *p = tok->value; *p; p++) {
+                    if (c->quoted) compile_quoted(c, *p);
+                    else compile_literal(c, VM_REG_WORD, *p);
+                }
+
+                free(tok->value);
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_STAR:
+                compile_quoted(c, '*');
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_QUESTION_MARK:
+                compile_quoted(c, '?');
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_DOUBLE_QUOTE:
+                c->quoted = !c->quoted;
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_SINGLE_QUOTE:
+                if (c->quoted && !c->single_quoted) {
+                    compile_literal(c, VM_REG_WORD, '\'');
+                    NEXT_TOKEN();
+                }
+
+                c->single_quoted = !c->single_quoted;
+                c->quoted = !c->quoted;
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_REDIRECT_IN:
+            case TOKEN_TYPE_REDIRECT_OUT:
+            case TOKEN_TYPE_REDIRECT_APPEND: {
+                if (c->quoted) {
+                    if (tok->type == TOKEN_TYPE_REDIRECT_APPEND) compile_literal(c, VM_REG_WORD, '>');
+                    compile_literal(c, VM_REG_WORD, (tok->type == TOKEN_TYPE_REDIRECT_IN) ? '<' : '>');
+                    NEXT_TOKEN();
+                }
+
+                if (c->redirect >= 0 || (!c->argc && !c->word)) {
+                    compile_error(c, tok);
+                    break;
+                }
+
+                // The word before the '>' is an argument, not part of the file name
+                if (c->word) compile_word(c);
+                c->redirect = (tok->type == TOKEN_TYPE_REDIRECT_IN) ? STDIN_FILENO : STDOUT_FILENO;
+                if (tok->type == TOKEN_TYPE_REDIRECT_APPEND) c->redirect |= VM_REDIRECT_APPEND;
+
+                token_t *spc = lexer_getToken(tok);
+                while (spc && spc->type == TOKEN_TYPE_SPACE) {
+                    token_t *next = lexer_getToken(spc);
+                    free(spc);
+                    spc = next;
+                }
+
+                lexer_ungetToken(spc);
+                NEXT_TOKEN();
+            }
+
+            case TOKEN_TYPE_OR:
+            case TOKEN_TYPE_AND:
+            case TOKEN_TYPE_PIPE:
+            case TOKEN_TYPE_SEMICOLON: {
+                if (c->quoted) {
+                    const char *text = (tok->type == TOKEN_TYPE_OR) ? "||" : (tok->type == TOKEN_TYPE_AND) ? "&&" : (tok->type == TOKEN_TYPE_PIPE) ? "|" : ";";
+                    while (*text) compile_literal(c, VM_REG_WORD, *text++);
+                    NEXT_TOKEN();
+                }
+
+                if (c->redirect >= 0) {
+                    if (!c->word) {
+                        compile_error(c, tok);
+                        break;
+                    }
+
+                    compile_redirect(c);
+                }
+
+                if (c->word) compile_word(c);
+
+                // A list can follow a compound command, nothing can be chained to it
+                int ok = c->argc || (c->compound && tok->type == TOKEN_TYPE_SEMICOLON);
+                if (!ok) {
+                    compile_error(c, tok);
+                    break;
+                }
+
+                int flags = 0;
+                if (tok->type == TOKEN_TYPE_OR) flags = COMMAND_FLAG_OR;
+                if (tok->type == TOKEN_TYPE_AND) flags = COMMAND_FLAG_AND;
+                if (tok->type == TOKEN_TYPE_PIPE) flags = COMMAND_FLAG_PIPE_FROM_PREV;
+
+                if (c->compound) compile_execute(c);
+                else compile_command(c, flags);
+                NEXT_TOKEN();
+            }
+
+            case TOKEN_TYPE_EQUALS:
+                if (c->quoted || c->argc || !c->word) {
+                    compile_literal(c, VM_REG_WORD, '=');
+
+                    // NAME=(...) as an argument, e.g. to declare
+                    char *arglist = c->quoted ? NULL : parser_readList();
+                    if (arglist) {
+                        compile_literal(c, VM_REG_WORD, '(');
+                        for (char *p = arglist; *p; p++) {
+                            if (EXPAND_IS_META(*p)) compile_literal(c, VM_REG_WORD, EXPAND_CTLESC);
+                            compile_literal(c, VM_REG_WORD, *p);
+                        }
+                        compile_literal(c, VM_REG_WORD, ')');
+                        free(arglist);
+                    }
+
+                    NEXT_TOKEN();
+                }
+
+                compile_assignment(c, tok);
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_NEWLINE:
+            case TOKEN_TYPE_EOF:
+                if (c->redirect >= 0) {
+                    if (!c->word) {
+                        compile_error(c, tok);
+                        break;
+                    }
+
+                    compile_redirect(c);
+                }
+
+                if (c->word) compile_word(c);
+                compile_execute(c);
+
+                if (!stop1) {
+                    result = 0;
+                    break;
+                }
+
+                if (tok->type == TOKEN_TYPE_EOF) {
+                    parser_error(input_getColumn(), "syntax error: unexpected end of file (expecting \"%s\")\n", stop2 ? stop2 : stop1);
+                    c->error = 1;
+                    break;
+                }
+
+                // Keep going on the next line
+                c->quoted = 0;
+                c->single_quoted = 0;
+                essence_prompt = INPUT_PROMPT_PS2;
+                input_get(NULL);
+                essence_prompt = INPUT_PROMPT_PS1;
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_DOLLAR:
+                if (c->single_quoted) {
+                    compile_literal(c, VM_REG_WORD, '$');
+                    NEXT_TOKEN();
+                }
+
+                compile_dollar(c, tok, VM_REG_WORD, c->quoted ? EXPAND_FLAG_QUOTED : 0);
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_TILDE:
+                if (c->quoted) compile_literal(c, VM_REG_WORD, '~');
+                else compile_expansion(c, VM_OP_HOME, VM_REG_WORD, 0, 0);
+                NEXT_TOKEN();
+
+            case TOKEN_TYPE_HASHTAG: {
+                if (c->quoted) {
+                    compile_literal(c, VM_REG_WORD, '#');
+                    NEXT_TOKEN();
+                }
+
+                token_t *n = lexer_getToken(tok);
+                while (n && n->type != TOKEN_TYPE_NEWLINE && n->type != TOKEN_TYPE_EOF) {
+                    if (n->type == TOKEN_TYPE_STRING) free(n->value);
+                    token_t *n2 = lexer_getToken(n);
+                    free(n);
+                    n = n2;
+                }
+
+                lexer_ungetToken(n);
+                NEXT_TOKEN();
+            }
+
+            default: {
+                // Only literal inside quotes
+                static const char chars[] = { [TOKEN_TYPE_AMPERSAND] = '&', [TOKEN_TYPE_OPEN_PAREN] = '(', [TOKEN_TYPE_CLOSE_PAREN] = ')' };
+                if (c->quoted && tok->type < (int)sizeof(chars) && chars[tok->type]) {
+                    compile_literal(c, VM_REG_WORD, chars[tok->type]);
+                    NEXT_TOKEN();
+                }
+
+                compile_error(c, tok);
+                break;
+            }
+        }
+
+        // Only a finished list or an error gets here
+        break;
+
+    _next_token: ;
+    }
+
+    if (tok) free(tok);
+    return c->error ? -1 : result;
+}
+
+/**
+ * @brief Set up the compiler state
+ * @param check Only checking syntax, the strings aren't kept
+ */
+void compile_init(compile_t *c, int check) {
+    memset(c, 0, sizeof(compile_t));
+    c->pool = buffer_create(4096);
+    c->literal = buffer_create(512);
+    c->redirect = -1;
+    c->check = check;
+
+    // Offset 0 of the pool is the empty string
+    buffer_push(c->pool, 0);
+}
+
+/**
+ * @brief Compile the next list of the input, the line just read (and the ones an if or while goes on to)
+ * @returns 0 on success, -1 on a syntax error (which has been reported, the rest of the line is dropped)
+ */
+int compile_line(compile_t *c) {
+    compile_list(c, NULL, NULL);
+    if (!c->error) return 0;
+
+    c->errors++;
+
+    // Start over on the next line
+    c->error = 0;
+    c->pending = 0;
+    c->argc = 0;
+    c->word = 0;
+    c->compound = 0;
+    c->redirect = -1;
+    c->literal->bufidx = 0;
+    c->literal->buffer[0] = 0;
+    parser_reset();
+    input_ungetCharacter(0);
+    return -1;
+}
+
+/**
+ * @brief End the code and get it as a program that can be run in place
+ */
+void compile_program(compile_t *c, vm_program_t *program) {
+    compile_emit(c, VM_OP_END, 0, 0, 0);
+
+    program->code = c->code;
+    program->code_count = c->code_count;
+    program->pool = c->pool->buffer;
+    program->pool_size = c->pool->bufidx;
+}
+
+/**
+ * @brief Compile the script that is loaded as input
+ * @param check Report every syntax error instead of stopping at the first
+ * @returns 0 on success, -1 on a syntax error (which has been reported)
+ */
+static int compile_input(compile_t *c, int check) {
+    compile_init(c, check);
+    parser_reset();
+
+    while (1) {
+        char *input = input_get(NULL);
+        if (!input || (*input == EOF)) break;
+        if (compile_line(c) < 0 && !c->check) break;
+    }
+
+    compile_emit(c, VM_OP_END, 0, 0, 0);
+    return c->errors ? -1 : 0;
+}
+
+/**
+ * @brief Free the compiler state
+ */
+void compile_destroy(compile_t *c) {
+    free(c->code);
+    free(c->strings);
+    buffer_destroy(c->pool);
+    buffer_destroy(c->literal);
+}
+
+/**
+ * @brief Lay out a compiled script the way it is stored (header, code, pool) and free the compiler state
+ * @param length Output length of the image
+ * @returns The image
+ */
+static char *compile_image(compile_t *c, size_t *length) {
+    vm_header_t header = { .version = VM_VERSION, .code_count = c->code_count, .pool_size = c->pool->bufidx };
+    memcpy(header.magic, VM_MAGIC, 4);
+
+    size_t code_size = c->code_count * sizeof(vm_instruction_t);
+    *length = sizeof(header) + code_size + c->pool->bufidx;
+
+    char *image = malloc(*length);
+    memcpy(image, &header, sizeof(header));
+    memcpy(image + sizeof(header), c->code, code_size);
+    memcpy(image + sizeof(header) + code_size, c->pool->buffer, c->pool->bufidx);
+
+    compile_destroy(c);
+    return image;
+}
+
+/**
+ * @brief Compile a script to bytecode
+ * @param source The script
+ * @param output The file to write the bytecode to
+ * @returns Exit status (0 on success, 2 on a syntax error)
+ */
+int compile_file(char *source, char *output) {
+    if (input_loadScript(source)) return 1;
+
+    compile_t c;
+    int error = compile_input(&c, 0);
+    input_switchInteractive();
+
+    size_t length;
+    char *image = compile_image(&c, &length);
+    if (error) {
+        free(image);
+        return 2;
+    }
+
+    int status = 0;
+    FILE *f = fopen(output, "w");
+    if (f) {
+        int ok = fwrite(image, 1, length, f) == length;
+        if (fclose(f) || !ok) f = NULL;
+    }
+
+    if (!f) {
+        fprintf(stderr, "essence: %s: %s\n", output, strerror(errno));
+        status = 1;
+    }
+
+    free(image);
+    return status;
+}
+
+/**
+ * @brief Check the syntax of a script without running or keeping anything
+ *
+ * Uses the grammar lines are run with, so an error is reported on the lines
+ * running the script would report it on, and nowhere else.
+ *
+ * @param filename The script
+ * @param stats Lines, bytes and errors are added to this
+ * @returns Exit status (0 if it is fine, 1 if it can't be read, 2 on syntax errors)
+ */
+int compile_check(char *filename, compile_stats_t *stats) {
+    if (input_loadScript(filename)) return 1;
+
+    stats->files++;
+    stats->bytes += input_script->length;
+
+    compile_t c;
+    int error = compile_input(&c, 1);
+    compile_destroy(&c);
+
+    stats->lines += input_script->line;
+    stats->errors += c.errors;
+
+    input_switchInteractive();
+    return error ? 2 : 0;
+}
+
+/**
+ * @brief Get a script compiled, from the cache if it hasn't changed since it was last compiled
+ *
+ * The current input is replaced, the caller saves it beforehand. A script
+ * that doesn't compile gets an entry too, marked to be interpreted instead.
+ *
+ * @param filename The script (source or compiled)
+ * @returns The cache entry, or NULL on error (which has been reported)
+ */
+compile_cache_t *compile_cached(char *filename) {
+    struct stat st;
+    if (stat(filename, &st) < 0) {
+        fprintf(stderr, "essence: %s: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    compile_cache_t **link = &compile_cache;
+    while (*link) {
+        compile_cache_t *entry = *link;
+        if (entry->dev == st.st_dev && entry->ino == st.st_ino) {
+            if (entry->size == st.st_size && entry->mtime.tv_sec == st.st_mtim.tv_sec && entry->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                return entry;
+            }
+
+            // Stale. One that is still running (sourced from itself) is freed by compile_release.
+            *link = entry->next;
+            entry->stale = 1;
+            if (!entry->running) {
+                free(entry->image);
+                free(entry);
+            }
+
+            break;
+        }
+
+        link = &entry->next;
+    }
+
+    if (input_loadScript(filename)) return NULL;
+
+    size_t length;
+    char *image;
+    if (vm_isProgram(input_script->data, input_script->length)) {
+        // Already compiled, the mapping goes away with the input so keep a copy
+        length = input_script->length;
+        image = malloc(length);
+        memcpy(image, input_script->data, length);
+    } else {
+        // Its syntax errors are reported when it is run line by line instead
+        compile_t c;
+        parser_quiet = 1;
+        int error = compile_input(&c, 0);
+        parser_quiet = 0;
+
+        image = compile_image(&c, &length);
+        if (error) {
+            free(image);
+            image = NULL;
+        }
+    }
+
+    compile_cache_t *entry = calloc(1, sizeof(compile_cache_t));
+    entry->interpret = !image;
+    if (image && vm_load(filename, image, length, &entry->program) < 0) {
+        free(image);
+        free(entry);
+        return NULL;
+    }
+
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtim;
+    entry->image = image;
+    entry->next = compile_cache;
+    compile_cache = entry;
+    return entry;
+}
+
+/**
+ * @brief Done running a cached script
+ * @param entry The entry from @c compile_cached
+ */
+void compile_release(compile_cache_t *entry) {
+    if (--entry->running || !entry->stale) return;
+
+    free(entry->image);
+    free(entry);
+}
@@ -0,0 +1,1003 @@
+/**
+ * @file complete.c
+ * @brief Tab completion
+ *
+ * Command names are completed from an index of the executables in PATH,
+ * sorted so a prefix is found by binary search. The index is built the
+ * first time it is needed. After that a Tab only stats the PATH directories
+ * and reads a directory again when its modification time changed. Changed
+ * directories are read at the same time on a few threads.
+ *
+ * Directory entries are told apart with d_type, only symlinks and file
+ * systems that don't fill it in need a stat().
+ *
+ * The matches of the last completion are kept. Completing the same word
+ * again, or a longer one, while the directory is unchanged (same inode and
+ * modification time) is answered from them without reading anything.
+ *
+ * Arguments of commands with a spec (the complete builtin) are completed
+ * from its word list, the cached output of its command and the files it
+ * asks for, instead of everything in the directory.
+ *
+ * With shopt -s fuzzycomplete a word matches every name that has its
+ * characters in order. All the names are gathered (and cached) as for an
+ * empty word, then scored on how the characters fall (word starts, runs)
+ * and on how often and how lately the name was used on a command line.
+ * The best one comes first.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+
+/* PATH directories, in order */
+static complete_dir_t *complete_dirs = NULL;
+static size_t complete_dir_count = 0;
+static char *complete_path = NULL;          // PATH the directories are from
+
+/* Debug statistics, see $COMPLETESTATS */
+complete_stats_t complete_stats = { 0 };
+
+/* Directories being read by the threads, each takes the next one */
+static complete_dir_t **complete_queue = NULL;
+static size_t complete_queue_count = 0;
+static size_t complete_queue_next = 0;
+
+/* All executables, sorted and without duplicates */
+static const char **complete_index = NULL;
+static size_t complete_index_count = 0;
+static unsigned long complete_index_version = 0;   // Changes whenever the index does
+
+/* Matches of the last completion */
+static complete_cache_t complete_cache = { 0 };
+
+/* Completion specs */
+static complete_spec_t *complete_specs = NULL;
+
+/* Words used on command lines, an open-addressing hash table */
+static complete_use_t *complete_uses = NULL;
+static size_t complete_use_size = 0;
+static size_t complete_use_count = 0;
+
+/* Fuzzy matches, best first (the names belong to the cache) */
+static complete_rank_t *complete_ranks = NULL;
+static char **complete_ranked = NULL;
+
+/**
+ * @brief Compare two names for sorting
+ */
+static int complete_compare(const void *a, const void *b) {
+    return strcmp(*(const char**)a, *(const char**)b);
+}
+
+/**
+ * @brief Read the executables in a PATH directory
+ */
+static void complete_readDir(complete_dir_t *dir) {
+    for (size_t i = 0; i < dir->count; i++) free(dir->names[i]);
+    free(dir->names);
+    dir->names = NULL;
+    dir->count = 0;
+    dir->entries = 0;
+    dir->stats = 0;
+    dir->read = 1;
+
+    DIR *d = opendir(dir->path);
+    if (!d) return;
+
+    size_t size = 0;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        dir->entries++;
+        if (e->d_name[0] == '.' || e->d_type == DT_DIR) continue;
+
+        // Whether it is executable still takes a stat(), but only once per directory change
+        struct stat st;
+        dir->stats++;
+        if (fstatat(dirfd(d), e->d_name, &st, 0) < 0 || S_ISDIR(st.st_mode) || !(st.st_mode & S_IXUSR)) continue;
+
+        if (dir->count == size) {
+            size = size ? size * 2 : 64;
+            dir->names = realloc(dir->names, size * sizeof(char*));
+        }
+
+        dir->names[dir->count++] = strdup(e->d_name);
+    }
+
+    closedir(d);
+}
+
+/**
+ * @brief Read queued directories until there are none left
+ */
+static void *complete_worker(void *arg) {
+    (void)arg;
+
+    while (1) {
+        size_t i = __atomic_fetch_add(&complete_queue_next, 1, __ATOMIC_RELAXED);
+        if (i >= complete_queue_count) return NULL;
+        complete_readDir(complete_queue[i]);
+    }
+}
+
+/**
+ * @brief Read the queued directories, on up to COMPLETE_THREADS threads
+ */
+static void complete_readQueued() {
+    pthread_t threads[COMPLETE_THREADS - 1];
+    size_t started = 0;
+
+    complete_queue_next = 0;
+
+    // This thread reads too, so one directory needs no threads at all
+    size_t wanted = (complete_queue_count < COMPLETE_THREADS ? complete_queue_count : COMPLETE_THREADS) - 1;
+    while (started < wanted && !pthread_create(&threads[started], NULL, complete_worker, NULL)) started++;
+
+    complete_worker(NULL);
+    for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    for (size_t i = 0; i < complete_queue_count; i++) {
+        complete_stats.entries += complete_queue[i]->entries;
+        complete_stats.stats += complete_queue[i]->stats;
+    }
+
+    complete_queue_count = 0;
+}
+
+/**
+ * @brief Bring the index up to date with PATH and its directories
+ */
+static void complete_updateIndex() {
+    const char *path = variable_get("PATH");
+    if (!path) path = "";
+
+    int changed = 0;
+
+    // A new PATH starts over, directories that are still in it are read again too
+    if (!complete_path || strcmp(complete_path, path)) {
+        for (size_t i = 0; i < complete_dir_count; i++) {
+            complete_dir_t *dir = &complete_dirs[i];
+            for (size_t j = 0; j < dir->count; j++) free(dir->names[j]);
+            free(dir->names);
+            free(dir->path);
+        }
+
+        free(complete_path);
+        complete_path = strdup(path);
+        complete_dir_count = 0;
+
+        for (const char *p = path; ; ) {
+            const char *end = strchr(p, ':');
+            size_t length = end ? (size_t)(end - p) : strlen(p);
+
+            // An empty entry is the working directory, which is completed anyway
+            if (length) {
+                complete_dirs = realloc(complete_dirs, (complete_dir_count + 1) * sizeof(complete_dir_t));
+                complete_dirs[complete_dir_count++] = (complete_dir_t){ .path = strndup(p, length) };
+            }
+
+            if (!end) break;
+            p = end + 1;
+        }
+
+        changed = 1;
+    }
+
+    // A name added or removed changes the modification time of its directory
+    for (size_t i = 0; i < complete_dir_count; i++) {
+        complete_dir_t *dir = &complete_dirs[i];
+
+        struct stat st;
+        struct timespec mtime = { 0, 0 };
+        if (!stat(dir->path, &st)) mtime = st.st_mtim;
+
+        if (dir->read && mtime.tv_sec == dir->mtime.tv_sec && mtime.tv_nsec == dir->mtime.tv_nsec) continue;
+
+        dir->mtime = mtime;
+        complete_queue = realloc(complete_queue, (complete_queue_count + 1) * sizeof(complete_dir_t*));
+        complete_queue[complete_queue_count++] = dir;
+        changed = 1;
+    }
+
+    if (complete_queue_count) complete_readQueued();
+
+    if (!changed) return;
+
+    // Merge the directories
+    size_t total = 0;
+    for (size_t i = 0; i < complete_dir_count; i++) total += complete_dirs[i].count;
+
+    complete_index = realloc(complete_index, (total ? total : 1) * sizeof(char*));
+    complete_index_count = 0;
+    for (size_t i = 0; i < complete_dir_count; i++) {
+        for (size_t j = 0; j < complete_dirs[i].count; j++) complete_index[complete_index_count++] = complete_dirs[i].names[j];
+    }
+
+    qsort(complete_index, complete_index_count, sizeof(char*), complete_compare);
+
+    // The same name in several directories is one command
+    size_t unique = 0;
+    for (size_t i = 0; i < complete_index_count; i++) {
+        if (!unique || strcmp(complete_index[unique - 1], complete_index[i])) complete_index[unique++] = complete_index[i];
+    }
+
+    complete_index_count = unique;
+    complete_index_version++;
+}
+
+/**
+ * @brief Find the names starting with a prefix in a sorted list
+ * @param list The list
+ * @param size Number of names in it
+ * @param prefix The prefix
+ * @param count Output number of matches
+ * @returns The first match, the matches follow in order
+ */
+static const char **complete_search(const char **list, size_t size, const char *prefix, size_t *count) {
+    size_t length = strlen(prefix);
+
+    // The first name that isn't before the prefix
+    size_t lo = 0, hi = size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(list[mid], prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    size_t end = lo;
+    while (end < size && !strncmp(list[end], prefix, length)) end++;
+
+    *count = end - lo;
+    return list + lo;
+}
+
+/**
+ * @brief Find the executables in PATH starting with a prefix
+ * @param prefix The prefix
+ * @param count Output number of matches
+ * @returns The first match, the matches follow in order
+ */
+const char **complete_findCommands(const char *prefix, size_t *count) {
+    complete_updateIndex();
+    return complete_search(complete_index, complete_index_count, prefix, count);
+}
+
+/**
+ * @brief Add a match to the cache
+ */
+static void complete_addMatch(const char *entry) {
+    if (complete_cache.count + 1 >= complete_cache.size) {
+        complete_cache.size = complete_cache.size ? complete_cache.size * 2 : COMPLETE_INITIAL_MATCHES;
+        complete_cache.matches = realloc(complete_cache.matches, complete_cache.size * sizeof(char*));
+    }
+
+    complete_cache.matches[complete_cache.count++] = strdup(entry);
+}
+
+/**
+ * @brief Answer from the matches of the last completion, if they still hold
+ * @returns 1 if they did
+ */
+static int complete_fromCache(const char *dir, const char *prefix, int commands, size_t limit, struct stat *st) {
+    complete_cache_t *c = &complete_cache;
+
+    if (!c->dir || strcmp(c->dir, dir) || c->commands != commands) return 0;
+    if (c->truncated && c->limit < limit) return 0;
+    if (c->dev != st->st_dev || c->ino != st->st_ino) return 0;
+    if (c->mtime.tv_sec != st->st_mtim.tv_sec || c->mtime.tv_nsec != st->st_mtim.tv_nsec) return 0;
+    if (commands && c->index_version != complete_index_version) return 0;
+
+    // A longer prefix only drops matches, unless some were never found
+    size_t length = strlen(c->prefix);
+    if (strncmp(prefix, c->prefix, length) || (c->truncated && prefix[length])) return 0;
+
+    if (prefix[length]) {
+        size_t prefix_length = strlen(prefix);
+        size_t kept = 0;
+
+        for (size_t i = 0; i < c->count; i++) {
+            if (!strncmp(c->matches[i], prefix, prefix_length)) c->matches[kept++] = c->matches[i];
+            else free(c->matches[i]);
+        }
+
+        c->count = kept;
+        c->matches[kept] = NULL;
+        c->masked = 0;
+        free(c->prefix);
+        c->prefix = strdup(prefix);
+    }
+
+    complete_stats.cached++;
+    return 1;
+}
+
+/**
+ * @brief Sort a list of names and drop the duplicates
+ * @returns The number of names left
+ */
+static size_t complete_sortUnique(char **list, size_t count) {
+    qsort(list, count, sizeof(char*), complete_compare);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique && !strcmp(list[unique - 1], list[i])) free(list[i]);
+        else list[unique++] = list[i];
+    }
+
+    return unique;
+}
+
+/**
+ * @brief Forget the last matches, they are about to be replaced
+ * @param limit Number of matches to stop at
+ */
+static void complete_resetCache(size_t limit) {
+    complete_cache_t *c = &complete_cache;
+    for (size_t i = 0; i < c->count; i++) free(c->matches[i]);
+    free(c->dir);
+    free(c->prefix);
+
+    c->dir = NULL;
+    c->prefix = NULL;
+    c->limit = limit;
+    c->truncated = 0;
+    c->masked = 0;
+    c->count = 0;
+
+    if (!c->matches) {
+        c->size = COMPLETE_INITIAL_MATCHES;
+        c->matches = malloc(c->size * sizeof(char*));
+    }
+}
+
+/**
+ * @brief Add the entries of a directory starting with a prefix to the matches
+ * @param spec Spec deciding which entries, NULL for all of them
+ */
+static void complete_readMatches(const char *dir, const char *prefix, complete_spec_t *spec) {
+    complete_cache_t *c = &complete_cache;
+    size_t prelen = strlen(prefix);
+
+    DIR *d = opendir(dir);
+    if (!d) return;
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        complete_stats.entries++;
+        if (e->d_name[0] == '.') continue;
+        if (strncmp(e->d_name, prefix, prelen)) continue;
+
+        if (c->count == c->limit) {
+            c->truncated = 1;
+            break;
+        }
+
+        // Directories get a '/', the entry type usually says which they are
+        int is_dir = (e->d_type == DT_DIR);
+        if (e->d_type == DT_UNKNOWN || e->d_type == DT_LNK) {
+            struct stat st;
+            complete_stats.stats++;
+            if (fstatat(dirfd(d), e->d_name, &st, 0) < 0) continue;
+            is_dir = S_ISDIR(st.st_mode);
+        }
+
+        if (spec && !is_dir) {
+            if (!(spec->flags & COMPLETE_SPEC_FILES)) continue;
+
+            if (spec->filter_pattern) {
+                int match = pattern_match(spec->filter_pattern, e->d_name, strlen(e->d_name));
+                if (match == (spec->filter[0] != '!')) continue;
+            }
+        }
+
+        char formatted[4096];
+        snprintf(formatted, sizeof(formatted), is_dir ? "%s/" : "%s", e->d_name);
+        complete_addMatch(formatted);
+    }
+
+    closedir(d);
+}
+
+/**
+ * @brief Find the spec for a command
+ */
+static complete_spec_t *complete_findSpec(const char *command) {
+    // /usr/bin/git is completed like git
+    const char *slash = strrchr(command, '/');
+    if (slash) command = slash + 1;
+
+    for (complete_spec_t *spec = complete_specs; spec; spec = spec->next) {
+        if (!strcmp(spec->name, command)) return spec;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Run the command of a spec and keep its output lines, sorted
+ * @param word The word being completed, in $COMP_WORD for the command
+ */
+static void complete_runSpec(complete_spec_t *spec, const char *word) {
+    for (size_t i = 0; i < spec->output_count; i++) free(spec->output[i]);
+    free(spec->output);
+    spec->output = NULL;
+    spec->output_count = 0;
+    spec->output_time = time(NULL);
+
+    int pfd[2];
+    if (pipe(pfd) < 0) return;
+
+    // Anything not written out yet would be written by the copy as well
+    fflush(stdout);
+
+    pid_t cpid = fork();
+    if (cpid < 0) {
+        close(pfd[0]);
+        close(pfd[1]);
+        return;
+    }
+
+    if (!cpid) {
+        // Run the command in a copy of ourselves, away from the terminal
+        cmd_job_control = 0;
+
+        int null = open("/dev/null", O_RDWR);
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDERR_FILENO);
+        dup2(pfd[1], STDOUT_FILENO);
+        close(pfd[0]);
+        close(pfd[1]);
+        close(null);
+
+        variable_set("COMP_WORD", word);
+
+        parser_reset();
+        input_loadBuffer(spec->command);
+        parser_interpret();
+
+        fflush(stdout);
+        _exit(cmd_last_exit_status);
+    }
+
+    close(pfd[1]);
+
+    buffer_t *out = buffer_create(4096);
+    char chunk[4096];
+
+    while (1) {
+        ssize_t r = read(pfd[0], chunk, sizeof(chunk));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        buffer_append(out, chunk, r);
+    }
+
+    close(pfd[0]);
+    while (waitpid(cpid, NULL, 0) < 0 && errno == EINTR);
+
+    // One candidate per line
+    size_t size = 0;
+    for (char *line = out->buffer; *line; ) {
+        size_t length = strcspn(line, "\n");
+        if (length) {
+            if (spec->output_count == size) {
+                size = size ? size * 2 : 64;
+                spec->output = realloc(spec->output, size * sizeof(char*));
+            }
+
+            spec->output[spec->output_count++] = strndup(line, length);
+        }
+
+        line += length;
+        if (*line) line++;
+    }
+
+    buffer_destroy(out);
+    spec->output_count = complete_sortUnique(spec->output, spec->output_count);
+}
+
+/**
+ * @brief Complete an argument of a command that has a spec
+ * @param word The whole word
+ * @param dir Directory part of it, for files
+ * @param prefix Name part of it, for files
+ * @param has_dir The word has a directory part, only files can match it
+ * @param fuzzy Gather everything, for fuzzy matching
+ */
+static void complete_bySpec(complete_spec_t *spec, const char *word, const char *dir, const char *prefix, int has_dir, int fuzzy) {
+    complete_resetCache(fuzzy ? COMPLETE_MAX_CANDIDATES : COMPLETE_MAX_MATCHES);
+    size_t limit = complete_cache.limit;
+
+    // Fuzzy matching needs all of them
+    const char *search = fuzzy ? "" : word;
+    if (fuzzy) prefix = "";
+
+    if (!has_dir) {
+        size_t n;
+        const char **words = complete_search((const char**)spec->words, spec->word_count, search, &n);
+        for (size_t i = 0; i < n && complete_cache.count < limit; i++) complete_addMatch(words[i]);
+
+        // The output of the command is kept for -t seconds
+        if (spec->command) {
+            if (!spec->ttl || !spec->output_time || time(NULL) - spec->output_time >= spec->ttl) complete_runSpec(spec, word);
+
+            const char **lines = complete_search((const char**)spec->output, spec->output_count, search, &n);
+            for (size_t i = 0; i < n && complete_cache.count < limit; i++) complete_addMatch(lines[i]);
+        }
+    }
+
+    if (spec->flags & (COMPLETE_SPEC_FILES | COMPLETE_SPEC_DIRS)) complete_readMatches(dir, prefix, spec);
+
+    complete_cache.count = complete_sortUnique(complete_cache.matches, complete_cache.count);
+    complete_cache.matches[complete_cache.count] = NULL;
+}
+
+/**
+ * @brief Hash a word
+ */
+static unsigned int complete_hash(const char *name, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Find the slot of a word in the table of used words
+ * @returns The slot, which is empty if it was never used
+ */
+static complete_use_t *complete_useSlot(const char *name, size_t length, unsigned int hash) {
+    size_t mask = complete_use_size - 1;
+    size_t i = hash & mask;
+
+    while (complete_uses[i].name) {
+        complete_use_t *u = &complete_uses[i];
+        if (u->hash == hash && !strncmp(u->name, name, length) && !u->name[length]) break;
+        i = (i + 1) & mask;
+    }
+
+    return &complete_uses[i];
+}
+
+/**
+ * @brief Count a use of a word
+ */
+static void complete_use(const char *name, size_t length, time_t now) {
+    // Keep the table at most half full
+    if ((complete_use_count + 1) * 2 > complete_use_size) {
+        complete_use_t *old = complete_uses;
+        size_t old_size = complete_use_size;
+
+        complete_use_size = old_size ? old_size * 2 : COMPLETE_INITIAL_USES;
+        complete_uses = calloc(complete_use_size, sizeof(complete_use_t));
+
+        for (size_t i = 0; i < old_size; i++) {
+            if (!old[i].name) continue;
+            *complete_useSlot(old[i].name, strlen(old[i].name), old[i].hash) = old[i];
+        }
+
+        free(old);
+    }
+
+    unsigned int hash = complete_hash(name, length);
+    complete_use_t *u = complete_useSlot(name, length, hash);
+    if (!u->name) {
+        u->name = strndup(name, length);
+        u->hash = hash;
+        complete_use_count++;
+    }
+
+    u->count++;
+    u->last = now;
+}
+
+/**
+ * @brief Get the tab completion statistics for $COMPLETESTATS
+ *
+ * Completions, last and longest time in microseconds, entries read and stat()
+ * calls by the last one, completions answered from cached matches and
+ * candidates scored by the last fuzzy one.
+ *
+ * @param buffer Output buffer
+ * @param size Size of the buffer
+ */
+void complete_getStats(char *buffer, size_t size) {
+    snprintf(buffer, size, "%zu %zu %zu %zu %zu %zu %zu", complete_stats.tabs, complete_stats.last_us, complete_stats.max_us,
+                complete_stats.entries, complete_stats.stats, complete_stats.cached, complete_stats.scored);
+}
+
+/**
+ * @brief Count the words of an accepted command line as used, for ranking fuzzy matches
+ *
+ * Words are counted by their last path component, which is what matches are.
+ */
+void complete_remember(const char *line) {
+    time_t now = time(NULL);
+
+    while (*line) {
+        line += strspn(line, " \t\n");
+        size_t length = strcspn(line, " \t\n");
+        if (!length) break;
+
+        // A directory counts with its '/', like it is listed
+        size_t end = length;
+        if (line[end - 1] == '/') end--;
+
+        size_t start = end;
+        while (start > 0 && line[start - 1] != '/') start--;
+        if (start < end) complete_use(line + start, length - start, now);
+
+        line += length;
+    }
+}
+
+/**
+ * @brief Get the set of characters in a string, case folded, as a bit mask
+ *
+ * Characters share bits, so a name having all the bits of the word is only
+ * a hint that it matches. It is cheap though, and rules out most names.
+ */
+static inline uint64_t complete_charMask(const char *str) {
+    uint64_t mask = 0;
+    for (; *str; str++) mask |= 1ull << (COMPLETE_FOLD(*str) & 63);
+    return mask;
+}
+
+/**
+ * @brief Score how well a name matches a word, fuzzily
+ * @param name The name
+ * @param word The word, case folded
+ * @param original The word as typed
+ * @returns The score, or -1 if the characters of the word aren't all in the name in order
+ */
+static int complete_score(const char *name, const char *word, const char *original) {
+    int score = 0;
+    size_t w = 0;
+    long last = -1;
+
+    for (size_t i = 0; name[i] && word[w]; i++) {
+        if (COMPLETE_FOLD(name[i]) != word[w]) continue;
+
+        score += COMPLETE_SCORE_MATCH;
+        if (name[i] == original[w]) score += COMPLETE_SCORE_CASE;
+        if (!i || name[i - 1] == '-' || name[i - 1] == '_' || name[i - 1] == '.' || name[i - 1] == '/') score += COMPLETE_SCORE_BOUNDARY;
+
+        if (last >= 0) {
+            long gap = (long)i - last - 1;
+            if (!gap) score += COMPLETE_SCORE_CONSECUTIVE;
+            else score -= (gap < COMPLETE_SCORE_GAP_MAX) ? gap : COMPLETE_SCORE_GAP_MAX;
+        }
+
+        last = i;
+        w++;
+    }
+
+    return word[w] ? -1 : score;
+}
+
+/**
+ * @brief Compare ranked names, best first, then by name
+ */
+static int complete_compareRank(const void *a, const void *b) {
+    const complete_rank_t *ra = a;
+    const complete_rank_t *rb = b;
+
+    if (ra->score != rb->score) return (ra->score < rb->score) ? 1 : -1;
+    return strcmp(ra->name, rb->name);
+}
+
+/**
+ * @brief Check if a ranked name is worse than another
+ */
+static inline int complete_worse(const complete_rank_t *a, const complete_rank_t *b) {
+    if (a->score != b->score) return a->score < b->score;
+    return strcmp(a->name, b->name) > 0;
+}
+
+/**
+ * @brief Move a ranked name down a heap that has the worst name on top
+ */
+static void complete_siftDown(complete_rank_t *heap, size_t count, size_t i) {
+    while (1) {
+        size_t worst = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+
+        if (left < count && complete_worse(&heap[left], &heap[worst])) worst = left;
+        if (right < count && complete_worse(&heap[right], &heap[worst])) worst = right;
+        if (worst == i) return;
+
+        complete_rank_t tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
+    }
+}
+
+/**
+ * @brief Rank the gathered names by how well they match a word
+ *
+ * Only the best COMPLETE_MAX_MATCHES are kept, in a heap with the worst of
+ * them on top, so a short word matching most of the names costs no sort of
+ * all of them.
+ *
+ * @param word The word (the name part)
+ * @returns Number of names that match, they are in complete_ranked
+ */
+static size_t complete_rank(const char *word) {
+    complete_cache_t *c = &complete_cache;
+
+    if (!complete_ranks) {
+        complete_ranks = malloc(COMPLETE_MAX_MATCHES * sizeof(complete_rank_t));
+        complete_ranked = malloc((COMPLETE_MAX_MATCHES + 1) * sizeof(char*));
+    }
+
+    // The masks are kept for as long as the names are
+    if (!c->masked) {
+        c->masks = realloc(c->masks, (c->count + 1) * sizeof(uint64_t));
+        for (size_t i = 0; i < c->count; i++) c->masks[i] = complete_charMask(c->matches[i]);
+        c->masked = 1;
+    }
+
+    char *folded = strdup(word);
+    for (char *p = folded; *p; p++) *p = COMPLETE_FOLD(*p);
+    uint64_t wanted = complete_charMask(folded);
+
+    time_t now = time(NULL);
+    size_t count = 0;
+
+    for (size_t i = 0; i < c->count; i++) {
+        if ((c->masks[i] & wanted) != wanted) continue;
+
+        complete_rank_t rank = { .name = c->matches[i] };
+        rank.score = complete_score(rank.name, folded, word);
+        if (rank.score < 0) continue;
+
+        // Names used before, often or lately, go first
+        if (complete_use_count) {
+            size_t length = strlen(rank.name);
+            complete_use_t *u = complete_useSlot(rank.name, length, complete_hash(rank.name, length));
+            if (u->name) {
+                rank.score += COMPLETE_SCORE_USE * ((u->count < COMPLETE_SCORE_USES) ? u->count : COMPLETE_SCORE_USES);
+                if (now - u->last < 3600) rank.score += COMPLETE_SCORE_HOUR;
+                else if (now - u->last < 86400) rank.score += COMPLETE_SCORE_DAY;
+            }
+        }
+
+        if (count < COMPLETE_MAX_MATCHES) {
+            complete_ranks[count++] = rank;
+            if (count == COMPLETE_MAX_MATCHES) {
+                for (size_t h = count / 2; h-- > 0; ) complete_siftDown(complete_ranks, count, h);
+            }
+        } else if (complete_worse(&complete_ranks[0], &rank)) {
+            complete_ranks[0] = rank;
+            complete_siftDown(complete_ranks, count, 0);
+        }
+    }
+
+    free(folded);
+    complete_stats.scored = c->count;
+
+    qsort(complete_ranks, count, sizeof(complete_rank_t), complete_compareRank);
+    for (size_t i = 0; i < count; i++) complete_ranked[i] = (char*)complete_ranks[i].name;
+    complete_ranked[count] = NULL;
+
+    return count;
+}
+
+/**
+ * @brief Get the completion specs
+ */
+complete_spec_t *complete_listSpecs() {
+    return complete_specs;
+}
+
+/**
+ * @brief Free a completion spec
+ */
+static void complete_freeSpec(complete_spec_t *spec) {
+    for (size_t i = 0; i < spec->word_count; i++) free(spec->words[i]);
+    for (size_t i = 0; i < spec->output_count; i++) free(spec->output[i]);
+    if (spec->filter_pattern) pattern_destroy(spec->filter_pattern);
+
+    free(spec->words);
+    free(spec->output);
+    free(spec->wordlist);
+    free(spec->command);
+    free(spec->filter);
+    free(spec->name);
+    free(spec);
+}
+
+/**
+ * @brief Remove the spec of a command
+ * @param name The command, NULL for all of them
+ * @returns 0, or -1 if there is no spec for it
+ */
+int complete_removeSpec(const char *name) {
+    int found = 0;
+
+    for (complete_spec_t **link = &complete_specs; *link; ) {
+        complete_spec_t *spec = *link;
+        if (name && strcmp(spec->name, name)) {
+            link = &spec->next;
+            continue;
+        }
+
+        *link = spec->next;
+        complete_freeSpec(spec);
+        found = 1;
+    }
+
+    return (found || !name) ? 0 : -1;
+}
+
+/**
+ * @brief Set how the arguments of a command are completed, replacing any spec it had
+ * @param name The command
+ * @param flags COMPLETE_SPEC_*
+ * @param wordlist Words separated by whitespace, or NULL
+ * @param command Command printing candidates one per line, or NULL
+ * @param ttl Seconds the output of the command is kept, 0 to run it every time
+ * @param filter Pattern of files to leave out ("!" in front: to keep), or NULL
+ */
+void complete_setSpec(const char *name, int flags, const char *wordlist, const char *command, int ttl, const char *filter) {
+    complete_removeSpec(name);
+
+    complete_spec_t *spec = calloc(1, sizeof(complete_spec_t));
+    spec->name = strdup(name);
+    spec->flags = flags;
+    spec->ttl = ttl;
+    if (command) spec->command = strdup(command);
+
+    if (wordlist) {
+        spec->wordlist = strdup(wordlist);
+
+        size_t size = 0;
+        for (const char *p = wordlist; *p; ) {
+            p += strspn(p, " \t\n");
+            size_t length = strcspn(p, " \t\n");
+            if (!length) break;
+
+            if (spec->word_count == size) {
+                size = size ? size * 2 : 16;
+                spec->words = realloc(spec->words, size * sizeof(char*));
+            }
+
+            spec->words[spec->word_count++] = strndup(p, length);
+            p += length;
+        }
+
+        spec->word_count = complete_sortUnique(spec->words, spec->word_count);
+    }
+
+    if (filter) {
+        spec->filter = strdup(filter);
+        const char *pattern = (*filter == '!') ? filter + 1 : filter;
+        spec->filter_pattern = pattern_compile(pattern, strlen(pattern));
+    }
+
+    spec->next = complete_specs;
+    complete_specs = spec;
+}
+
+/**
+ * @brief Complete a word
+ * @param str The word so far
+ * @param command The command the word is an argument of, NULL if it is the command name (commands in PATH are completed too)
+ * @param count Output number of matches
+ * @param ranked Output whether the matches are fuzzy, best first, instead of starting with the word
+ * @param truncated Output whether the search stopped at the limit, so there are more matches than these
+ * @returns A NULL-terminated list of matches, valid until the next completion
+ */
+char **complete_word(char *str, const char *command, size_t *count, int *ranked, int *truncated) {
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    complete_stats.entries = 0;
+    complete_stats.stats = 0;
+
+    char *input = strdup(str); 
+    char *dir = ".";
+    char *prefix = input;
+
+    if (input[0] == '~') {
+        struct passwd *pw = getpwuid(getuid());
+        if (pw) {
+            char tmp[4096];
+            snprintf(tmp, sizeof(tmp), "%s%s", pw->pw_dir, input+1);
+            free(input);
+            input = strdup(tmp);
+        }
+    }
+
+    char *slash = strrchr(input, '/');
+    if (slash) {
+        *slash = '\0';
+        dir = (*input ? input : "/");
+        prefix = slash + 1;
+    }
+
+    // Fuzzy matching starts from everything an empty word matches
+    int fuzzy = (essence_options & ESSENCE_OPTION_FUZZY) && *prefix;
+    const char *wanted = fuzzy ? "" : prefix;
+    size_t limit = fuzzy ? COMPLETE_MAX_CANDIDATES : COMPLETE_MAX_MATCHES;
+
+    complete_spec_t *spec = command ? complete_findSpec(command) : NULL;
+    if (spec) {
+        complete_bySpec(spec, str, dir, prefix, slash != NULL, fuzzy);
+        goto _done;
+    }
+
+    // The directory is looked at either way, whether it changed says if the last matches still hold
+    struct stat st;
+    int readable = !stat(dir, &st);
+    if (!readable) memset(&st, 0, sizeof(st));
+
+    // Arguments only match files, unless there is no directory to match them in
+    int commands = !slash && (!command || !readable);
+    if (commands) complete_updateIndex();
+
+    if (!complete_fromCache(dir, wanted, commands, limit, &st)) {
+        complete_resetCache(limit);
+
+        complete_cache_t *c = &complete_cache;
+        c->dir = strdup(dir);
+        c->prefix = strdup(wanted);
+        c->commands = commands;
+        c->dev = st.st_dev;
+        c->ino = st.st_ino;
+        c->mtime = st.st_mtim;
+        c->index_version = complete_index_version;
+
+        complete_readMatches(dir, wanted, NULL);
+
+        if (commands) {
+            size_t n;
+            const char **names = complete_search(complete_index, complete_index_count, wanted, &n);
+            for (size_t i = 0; i < n; i++) {
+                if (c->count == c->limit) {
+                    c->truncated = 1;
+                    break;
+                }
+
+                complete_addMatch(names[i]);
+            }
+        }
+
+        // Sorted once, so listing and cycling don't follow readdir order
+        // A command both in the directory and in PATH is one match
+        c->count = complete_sortUnique(c->matches, c->count);
+        c->matches[c->count] = NULL;
+    }
+
+_done:
+    *ranked = fuzzy;
+    *truncated = complete_cache.truncated;
+    *count = fuzzy ? complete_rank(prefix) : complete_cache.count;
+    free(input);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    complete_stats.tabs++;
+    complete_stats.last_us = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_nsec - start.tv_nsec) / 1000;
+    if (complete_stats.last_us > complete_stats.max_us) complete_stats.max_us = complete_stats.last_us;
+
+    return fuzzy ? complete_ranked : complete_cache.matches;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file edit.c
+ * @brief Line editing buffer and kill ring
+ *
+ * The line being edited is kept in a gap buffer: the free space sits at the
+ * cursor, so typing or deleting there never moves the rest of the line. Only
+ * moving the cursor moves text, and only the text between the old and the
+ * new position.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "edit.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/**
+ * @brief Initialize an empty line
+ */
+void edit_init(edit_line_t *e) {
+    e->size = EDIT_INITIAL_SIZE;
+    e->data = malloc(e->size);
+    e->gap_start = 0;
+    e->gap_end = e->size;
+}
+
+/**
+ * @brief Empty the line, keeping its memory
+ */
+void edit_clear(edit_line_t *e) {
+    e->gap_start = 0;
+    e->gap_end = e->size;
+}
+
+/**
+ * @brief Make room for some text at the cursor
+ */
+static void edit_reserve(edit_line_t *e, size_t length) {
+    if (e->gap_end - e->gap_start >= length) return;
+
+    size_t after = EDIT_AFTER_LENGTH(e);
+    size_t size = e->size;
+    while (size - EDIT_LENGTH(e) < length) size *= 2;
+
+    e->data = realloc(e->data, size);
+    memmove(e->data + size - after, e->data + e->gap_end, after);
+    e->gap_end = size - after;
+    e->size = size;
+}
+
+/**
+ * @brief Get the character at a position of the line
+ */
+int edit_at(edit_line_t *e, size_t index) {
+    if (index < e->gap_start) return (unsigned char)e->data[index];
+    return (unsigned char)e->data[index + e->gap_end - e->gap_start];
+}
+
+/**
+ * @brief Move the cursor
+ * @param position The new position, at most the length of the line
+ */
+void edit_moveTo(edit_line_t *e, size_t position) {
+    if (position < e->gap_start) {
+        size_t n = e->gap_start - position;
+        memmove(e->data + e->gap_end - n, e->data + position, n);
+        e->gap_start -= n;
+        e->gap_end -= n;
+    } else if (position > e->gap_start) {
+        size_t n = position - e->gap_start;
+        memmove(e->data + e->gap_start, e->data + e->gap_end, n);
+        e->gap_start += n;
+        e->gap_end += n;
+    }
+}
+
+/**
+ * @brief Insert text at the cursor, leaving the cursor after it
+ */
+void edit_insert(edit_line_t *e, const char *text, size_t length) {
+    edit_reserve(e, length);
+    memcpy(e->data + e->gap_start, text, length);
+    e->gap_start += length;
+}
+
+/**
+ * @brief Remove part of the line, the cursor ends up at its start
+ * @param from Start of the part
+ * @param to End of the part (exclusive)
+ */
+void edit_erase(edit_line_t *e, size_t from, size_t to) {
+    edit_moveTo(e, to);
+    e->gap_start = from;
+}
+
+/**
+ * @brief Replace the whole line, leaving the cursor at the end
+ *
+ * The memory is only reallocated if the text doesn't fit.
+ */
+void edit_set(edit_line_t *e, const char *text, size_t length) {
+    edit_clear(e);
+    edit_insert(e, text, length);
+}
+
+/**
+ * @brief Copy part of the line
+ * @returns A new string
+ */
+char *edit_copy(edit_line_t *e, size_t from, size_t to) {
+    char *out = malloc(to - from + 1);
+    char *p = out;
+
+    if (from < e->gap_start) {
+        size_t n = ((to < e->gap_start) ? to : e->gap_start) - from;
+        memcpy(p, e->data + from, n);
+        p += n;
+        from += n;
+    }
+
+    if (from < to) {
+        memcpy(p, e->data + from + e->gap_end - e->gap_start, to - from);
+        p += to - from;
+    }
+
+    *p = 0;
+    return out;
+}
+
+/**
+ * @brief Check for a word character
+ */
+static int edit_isWord(int ch, int spaces_only) {
+    if (spaces_only) return !isspace(ch);
+    return isalnum(ch) || ch == '_' || ch >= 0x80;
+}
+
+/**
+ * @brief Find the start of the word before a position
+ * @param spaces_only Words are only separated by whitespace (for Ctrl-W)
+ */
+size_t edit_wordLeft(edit_line_t *e, size_t position, int spaces_only) {
+    while (position && !edit_isWord(edit_at(e, position - 1), spaces_only)) position--;
+    while (position && edit_isWord(edit_at(e, position - 1), spaces_only)) position--;
+    return position;
+}
+
+/**
+ * @brief Find the end of the word after a position
+ */
+size_t edit_wordRight(edit_line_t *e, size_t position) {
+    size_t length = EDIT_LENGTH(e);
+    while (position < length && !edit_isWord(edit_at(e, position), 0)) position++;
+    while (position < length && edit_isWord(edit_at(e, position), 0)) position++;
+    return position;
+}
+
+/**
+ * @brief Add killed text to the kill ring
+ * @param text The text, which the ring takes over
+ * @param how EDIT_KILL_NEW, or how to join it to the newest entry
+ */
+void edit_kill(edit_kill_ring_t *ring, char *text, int how) {
+    if (how != EDIT_KILL_NEW && ring->count) {
+        char *top = ring->entries[ring->head];
+        size_t top_length = strlen(top);
+        size_t length = strlen(text);
+
+        top = realloc(top, top_length + length + 1);
+        if (how == EDIT_KILL_APPEND) {
+            memcpy(top + top_length, text, length + 1);
+        } else {
+            memmove(top + length, top, top_length + 1);
+            memcpy(top, text, length);
+        }
+
+        free(text);
+        ring->entries[ring->head] = top;
+        ring->yank = ring->head;
+        return;
+    }
+
+    if (ring->count) ring->head = (ring->head + 1) % EDIT_KILL_RING_SIZE;
+    free(ring->entries[ring->head]);
+    ring->entries[ring->head] = text;
+    if (ring->count < EDIT_KILL_RING_SIZE) ring->count++;
+    ring->yank = ring->head;
+}
+
+/**
+ * @brief Get the newest killed text
+ * @returns The text, or NULL if nothing has been killed
+ */
+const char *edit_yank(edit_kill_ring_t *ring) {
+    if (!ring->count) return NULL;
+
+    ring->yank = ring->head;
+    return ring->entries[ring->head];
+}
+
+/**
+ * @brief Get the killed text before the one yanked last, going round the ring
+ * @returns The text, or NULL if nothing has been killed
+ */
+const char *edit_yankPop(edit_kill_ring_t *ring) {
+    if (!ring->count) return NULL;
+
+    size_t age = (ring->head + EDIT_KILL_RING_SIZE - ring->yank) % EDIT_KILL_RING_SIZE;
+    age = (age + 1) % ring->count;
+    ring->yank = (ring->head + EDIT_KILL_RING_SIZE - age) % EDIT_KILL_RING_SIZE;
+    return ring->entries[ring->yank];
+}
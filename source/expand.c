@@ -0,0 +1,1508 @@
+/**
+ * @file expand.c
+ * @brief Word expansion
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/wait.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+/* Directory reader */
+typedef struct expand_dir {
+#ifdef __linux__
+    int fd;                     // Directory file descriptor
+    char *buf;                  // getdents64 buffer
+    long len;                   // Bytes in buffer
+    long off;                   // Current offset in buffer
+#else
+    DIR *dir;                   // Directory stream
+#endif
+} expand_dir_t;
+
+#ifdef __linux__
+struct expand_dirent64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+/* Truncate a scratch buffer */
+#define EXPAND_TRUNCATE(b, len) ({ (b)->bufidx = (len); (b)->buffer[(len)] = 0; })
+
+/* Brace sequence expression */
+typedef struct expand_sequence {
+    long long start;            // First value
+    long long end;              // Last value
+    long long step;             // Increment (always positive)
+    int width;                  // Zero padded width
+    int alpha;                  // Values are characters
+} expand_sequence_t;
+
+/* Glob path component */
+typedef struct expand_component {
+    pattern_t *pattern;         // Compiled component
+    int globstar;               // Component is a ** under globstar
+} expand_component_t;
+
+/* Glob state */
+typedef struct expand_glob {
+    buffer_t *path;             // Path currently being walked
+    buffer_t *results;          // Matched paths, NUL-separated
+    size_t *offsets;            // Offset of each match in results
+    size_t count;               // Match count
+    size_t size;                // Allocated offsets
+
+    expand_component_t *components;
+    size_t component_count;
+    int trailing_slash;         // Pattern ended in '/', only match directories
+} expand_glob_t;
+
+/**
+ * @brief Open a directory for reading
+ * @param d The reader to fill
+ * @param path The directory path ("" for the current directory)
+ * @returns 0 on success
+ */
+static int expand_openDirectory(expand_dir_t *d, const char *path) {
+#ifdef __linux__
+    d->fd = open(*path ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (d->fd < 0) return -1;
+
+    d->buf = malloc(EXPAND_DIRENT_BUFFER_SIZE);
+    d->len = 0;
+    d->off = 0;
+#else
+    d->dir = opendir(*path ? path : ".");
+    if (!d->dir) return -1;
+#endif
+    return 0;
+}
+
+/**
+ * @brief Read the next directory entry
+ * @param d The reader
+ * @param name Output name (valid until the next read)
+ * @param type Output d_type
+ * @returns 1 if an entry was read, 0 at the end of the directory
+ */
+static int expand_readDirectory(expand_dir_t *d, char **name, int *type) {
+#ifdef __linux__
+    if (d->off >= d->len) {
+        d->len = syscall(SYS_getdents64, d->fd, d->buf, EXPAND_DIRENT_BUFFER_SIZE);
+        d->off = 0;
+        if (d->len <= 0) return 0;
+    }
+
+    struct expand_dirent64 *ent = (struct expand_dirent64*)(d->buf + d->off);
+    d->off += ent->d_reclen;
+
+    *name = ent->d_name;
+    *type = ent->d_type;
+#else
+    struct dirent *ent = readdir(d->dir);
+    if (!ent) return 0;
+
+    *name = ent->d_name;
+    *type = ent->d_type;
+#endif
+    return 1;
+}
+
+/**
+ * @brief Close a directory reader
+ */
+static void expand_closeDirectory(expand_dir_t *d) {
+#ifdef __linux__
+    close(d->fd);
+    free(d->buf);
+#else
+    closedir(d->dir);
+#endif
+}
+
+/**
+ * @brief Remove quote markers from a word
+ * @param word The word, modified in place
+ * @returns @c word
+ */
+char *expand_removeQuotes(char *word) {
+    char *src = word;
+    char *dst = word;
+
+    while (*src) {
+        if (*src == EXPAND_CTLESC && src[1]) src++;
+        else if (*src == EXPAND_CTLSPLIT) *src = ' ';
+        *dst++ = *src++;
+    }
+
+    *dst = 0;
+    return word;
+}
+
+/**
+ * @brief Append a name to the glob path
+ * @returns The previous path length, for @c expand_pathPop
+ */
+static size_t expand_pathPush(expand_glob_t *g, const char *name) {
+    size_t saved = g->path->bufidx;
+    if (saved && g->path->buffer[saved-1] != '/') buffer_push(g->path, '/');
+    buffer_pushString(g->path, (char*)name);
+    return saved;
+}
+
+/**
+ * @brief Truncate the glob path
+ */
+static void expand_pathPop(expand_glob_t *g, size_t saved) {
+    EXPAND_TRUNCATE(g->path, saved);
+}
+
+/**
+ * @brief Check whether the current glob path is a directory
+ * @param type d_type of the entry
+ * @param follow Follow symbolic links
+ */
+static int expand_isDirectory(expand_glob_t *g, int type, int follow) {
+    if (type == DT_DIR) return 1;
+    if (type != DT_UNKNOWN && (type != DT_LNK || !follow)) return 0;
+
+    struct stat st;
+    if ((follow ? stat : lstat)(g->path->buffer, &st) < 0) return 0;
+    return S_ISDIR(st.st_mode);
+}
+
+/**
+ * @brief Check whether a directory entry is visible to a wildcard
+ */
+static int expand_isVisible(pattern_t *pat, const char *name) {
+    if (name[0] != '.') return 1;
+    if (!name[1] || (name[1] == '.' && !name[2])) return 0;
+    return (pat && (pat->flags & PATTERN_FLAG_DOT)) || (essence_options & ESSENCE_OPTION_DOTGLOB);
+}
+
+/**
+ * @brief Record the current glob path as a match
+ */
+static void expand_globAdd(expand_glob_t *g) {
+    if (g->count >= g->size) {
+        g->size *= 2;
+        g->offsets = realloc(g->offsets, g->size * sizeof(size_t));
+    }
+
+    g->offsets[g->count++] = g->results->bufidx;
+    buffer_pushString(g->results, g->path->buffer);
+    if (g->trailing_slash) buffer_push(g->results, '/');
+    buffer_push(g->results, 0);
+}
+
+static void expand_globWalk(expand_glob_t *g, size_t idx);
+
+/**
+ * @brief Walk every directory below the current path for a ** component
+ */
+static void expand_globStar(expand_glob_t *g, size_t idx) {
+    int last = (idx + 1 == g->component_count);
+
+    expand_dir_t d;
+    if (expand_openDirectory(&d, g->path->buffer)) return;
+
+    char *name;
+    int type;
+    while (expand_readDirectory(&d, &name, &type)) {
+        if (!expand_isVisible(NULL, name)) continue;
+
+        size_t saved = expand_pathPush(g, name);
+
+        // Don't follow symlinks, or we could loop forever
+        int dir = expand_isDirectory(g, type, 0);
+        if (last && (dir || !g->trailing_slash)) expand_globAdd(g);
+
+        if (dir) {
+            if (!last) expand_globWalk(g, idx + 1);
+            expand_globStar(g, idx);
+        }
+
+        expand_pathPop(g, saved);
+    }
+
+    expand_closeDirectory(&d);
+}
+
+/**
+ * @brief Match glob component @c idx against the current path
+ */
+static void expand_globWalk(expand_glob_t *g, size_t idx) {
+    expand_component_t *c = &g->components[idx];
+    int last = (idx + 1 == g->component_count);
+
+    if (c->globstar) {
+        // Zero directories, then every directory below us
+        if (!last) expand_globWalk(g, idx + 1);
+        expand_globStar(g, idx);
+        return;
+    }
+
+    if (!(c->pattern->flags & PATTERN_FLAG_MAGIC)) {
+        // Literal component, no need to read the directory
+        size_t saved = expand_pathPush(g, c->pattern->pool);
+
+        if (!last) {
+            expand_globWalk(g, idx + 1);
+        } else {
+            struct stat st;
+            if (!lstat(g->path->buffer, &st) && (!g->trailing_slash || expand_isDirectory(g, DT_UNKNOWN, 1))) {
+                expand_globAdd(g);
+            }
+        }
+
+        expand_pathPop(g, saved);
+        return;
+    }
+
+    expand_dir_t d;
+    if (expand_openDirectory(&d, g->path->buffer)) return;
+
+    char *name;
+    int type;
+    while (expand_readDirectory(&d, &name, &type)) {
+        if (!expand_isVisible(c->pattern, name)) continue;
+        if (!pattern_match(c->pattern, name, strlen(name))) continue;
+
+        size_t saved = expand_pathPush(g, name);
+
+        if (last) {
+            if (!g->trailing_slash || expand_isDirectory(g, type, 1)) expand_globAdd(g);
+        } else if (expand_isDirectory(g, type, 1)) {
+            expand_globWalk(g, idx + 1);
+        }
+
+        expand_pathPop(g, saved);
+    }
+
+    expand_closeDirectory(&d);
+}
+
+/**
+ * @brief Sort comparator for glob results
+ */
+static int expand_compare(const void *a, const void *b) {
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+/**
+ * @brief Perform pathname expansion on a word
+ * @param cmd The command to push matches to
+ * @param word The word, with quoted characters escaped by @c EXPAND_CTLESC
+ * @returns Number of matches pushed
+ */
+int expand_glob(command_t *cmd, char *word) {
+    expand_glob_t g;
+    g.component_count = 0;
+    g.trailing_slash = 0;
+
+    // Compile each path component once
+    size_t max_components = 1;
+    for (char *p = word; *p; p++) if (*p == '/') max_components++;
+    g.components = malloc(sizeof(expand_component_t) * max_components);
+
+    char *p = word;
+    while (*p) {
+        char *end = strchr(p, '/');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+
+        if (len) {
+            expand_component_t *c = &g.components[g.component_count++];
+            c->pattern = pattern_compile(p, len);
+            c->globstar = (len == 2 && !strncmp(p, "**", 2) && (essence_options & ESSENCE_OPTION_GLOBSTAR));
+        }
+
+        if (!end) break;
+        if (!end[1]) g.trailing_slash = 1;
+        p = end + 1;
+    }
+
+    g.path = buffer_create(256);
+    if (*word == '/') buffer_push(g.path, '/');
+
+    g.results = buffer_create(1024);
+    g.size = 16;
+    g.count = 0;
+    g.offsets = malloc(sizeof(size_t) * g.size);
+
+    if (g.component_count) expand_globWalk(&g, 0);
+
+    if (g.count) {
+        char **sorted = malloc(sizeof(char*) * g.count);
+        for (size_t i = 0; i < g.count; i++) sorted[i] = g.results->buffer + g.offsets[i];
+        qsort(sorted, g.count, sizeof(char*), expand_compare);
+
+        for (size_t i = 0; i < g.count; i++) {
+            COMMAND_PUSH_ARGV(cmd, strdup(sorted[i]));
+        }
+
+        free(sorted);
+    }
+
+    for (size_t i = 0; i < g.component_count; i++) pattern_destroy(g.components[i].pattern);
+    free(g.components);
+    free(g.offsets);
+    buffer_destroy(g.path);
+    buffer_destroy(g.results);
+
+    return g.count;
+}
+
+/**
+ * @brief Push a fully brace-expanded word, performing pathname expansion
+ * @param cmd The command to push to
+ * @param word The word. Not consumed.
+ */
+static void expand_pushFinal(command_t *cmd, char *word) {
+    if (pattern_hasMagic(word, strlen(word))) {
+        if (expand_glob(cmd, word)) return;
+        if (essence_options & ESSENCE_OPTION_NULLGLOB) return;
+    }
+
+    COMMAND_PUSH_ARGV(cmd, expand_removeQuotes(strdup(word)));
+}
+
+/**
+ * @brief Find the closing brace of a brace expression
+ * @param str Pointer to the opening '{'
+ * @param comma Set if the expression has a top-level comma
+ * @returns Pointer to the matching '}', or NULL
+ */
+static char *expand_braceClose(char *str, int *comma) {
+    int depth = 0;
+    *comma = 0;
+
+    for (char *p = str; *p; p++) {
+        if (*p == EXPAND_CTLESC) { if (p[1]) p++; continue; }
+
+        if (*p == '{') depth++;
+        else if (*p == '}' && !--depth) return p;
+        else if (*p == ',' && depth == 1) *comma = 1;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Parse one endpoint of a brace sequence
+ * @returns 1 for a number, 2 for a single character, 0 if invalid
+ */
+static int expand_braceEndpoint(char *str, long long *value, int *width) {
+    if (!*str) return 0;
+
+    char *end;
+    long long v = strtoll(str, &end, 10);
+    if (!*end && end != str && (isdigit((unsigned char)str[0]) || str[0] == '-' || str[0] == '+')) {
+        char *digits = (*str == '-' || *str == '+') ? str + 1 : str;
+        *value = v;
+        *width = (digits[0] == '0' && digits[1]) ? (int)strlen(str) : 0;
+        return 1;
+    }
+
+    if (!str[1] && isalpha((unsigned char)str[0])) {
+        *value = (unsigned char)str[0];
+        *width = 0;
+        return 2;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Parse the body of a sequence expression (x..y[..incr])
+ * @param str The body (between the braces)
+ * @param length Length of the body
+ * @returns 1 if this is a valid sequence
+ */
+static int expand_braceSequence(char *str, size_t length, expand_sequence_t *seq) {
+    char tmp[128];
+    if (length >= sizeof(tmp)) return 0;
+    memcpy(tmp, str, length);
+    tmp[length] = 0;
+
+    char *dots = strstr(tmp, "..");
+    if (!dots) return 0;
+    *dots = 0;
+
+    char *end = dots + 2;
+    char *incr = strstr(end, "..");
+    if (incr) { *incr = 0; incr += 2; }
+
+    int start_width, end_width;
+    int start_kind = expand_braceEndpoint(tmp, &seq->start, &start_width);
+    int end_kind = expand_braceEndpoint(end, &seq->end, &end_width);
+    if (!start_kind || start_kind != end_kind) return 0;
+
+    seq->alpha = (start_kind == 2);
+    seq->width = (start_width > end_width) ? start_width : end_width;
+    seq->step = 1;
+
+    if (incr) {
+        char *e;
+        long long step = strtoll(incr, &e, 10);
+        if (*e || e == incr) return 0;
+        if (step) seq->step = (step < 0) ? -step : step;
+    }
+
+    return 1;
+}
+
+static void expand_brace(command_t *cmd, buffer_t *out, char *word);
+
+/**
+ * @brief Expand one alternative of a brace list followed by the rest of the word
+ */
+static void expand_braceAlternative(command_t *cmd, buffer_t *out, char *alt, size_t length, char *suffix) {
+    if (!memchr(alt, '{', length)) {
+        for (size_t i = 0; i < length; i++) buffer_push(out, alt[i]);
+        expand_brace(cmd, out, suffix);
+        return;
+    }
+
+    // Nested braces, they have to be expanded together with the suffix
+    size_t suffix_length = strlen(suffix);
+    char *joined = malloc(length + suffix_length + 1);
+    memcpy(joined, alt, length);
+    memcpy(joined + length, suffix, suffix_length + 1);
+    expand_brace(cmd, out, joined);
+    free(joined);
+}
+
+/**
+ * @brief Brace expand a word, pushing each result as it is generated
+ * @param cmd The command to push to
+ * @param out Scratch buffer holding the already expanded prefix
+ * @param word The rest of the word
+ */
+static void expand_brace(command_t *cmd, buffer_t *out, char *word) {
+    size_t saved = out->bufidx;
+
+    // Find the first valid brace expression
+    char *open = word;
+    char *close = NULL;
+    int comma = 0;
+    expand_sequence_t seq;
+    int is_seq = 0;
+
+    for (; *open; open++) {
+        if (*open == EXPAND_CTLESC) { if (open[1]) open++; continue; }
+        if (*open != '{') continue;
+
+        close = expand_braceClose(open, &comma);
+        if (close && comma) break;
+        if (close && (is_seq = expand_braceSequence(open + 1, close - open - 1, &seq))) break;
+        close = NULL;
+    }
+
+    if (!close) {
+        buffer_pushString(out, word);
+        expand_pushFinal(cmd, out->buffer);
+        EXPAND_TRUNCATE(out, saved);
+        return;
+    }
+
+    for (char *p = word; p < open; p++) buffer_push(out, *p);
+    size_t base = out->bufidx;
+
+    if (is_seq) {
+        char tmp[64];
+        long long dir = (seq.start <= seq.end) ? 1 : -1;
+
+        for (long long v = seq.start; (dir > 0) ? (v <= seq.end) : (v >= seq.end); v += dir * seq.step) {
+            if (seq.alpha) snprintf(tmp, sizeof(tmp), "%c", (int)v);
+            else snprintf(tmp, sizeof(tmp), "%0*lld", seq.width, v);
+
+            buffer_pushString(out, tmp);
+            expand_brace(cmd, out, close + 1);
+            EXPAND_TRUNCATE(out, base);
+        }
+    } else {
+        char *alt = open + 1;
+        int depth = 0;
+
+        for (char *p = open + 1; p <= close; p++) {
+            if (*p == EXPAND_CTLESC && p < close) { p++; continue; }
+
+            if (*p == '{') depth++;
+            else if (*p == '}' && depth) depth--;
+            else if ((*p == ',' && !depth) || p == close) {
+                expand_braceAlternative(cmd, out, alt, p - alt, close + 1);
+                EXPAND_TRUNCATE(out, base);
+                alt = p + 1;
+            }
+        }
+    }
+
+    EXPAND_TRUNCATE(out, saved);
+}
+
+/**
+ * @brief Brace and pathname expand a single field and push the results to a command
+ * @param cmd The command to push to
+ * @param word The field, with quoted characters escaped by @c EXPAND_CTLESC. Not consumed.
+ */
+static void expand_pushField(command_t *cmd, char *word) {
+    if (!strchr(word, '{')) {
+        expand_pushFinal(cmd, word);
+        return;
+    }
+
+    buffer_t *out = buffer_create(strlen(word) + 64);
+    expand_brace(cmd, out, word);
+    buffer_destroy(out);
+}
+
+/**
+ * @brief Expand a word and push the results to a command
+ * @param cmd The command to push to
+ * @param word The word. Fields separated by @c EXPAND_CTLSPLIT become separate words. Not consumed.
+ */
+void expand_pushWord(command_t *cmd, char *word) {
+    if (!strchr(word, EXPAND_CTLSPLIT)) {
+        expand_pushField(cmd, word);
+        return;
+    }
+
+    char *start = word;
+    for (char *p = word; ; p++) {
+        if (*p == EXPAND_CTLESC && p[1]) { p++; continue; }
+        if (*p && *p != EXPAND_CTLSPLIT) continue;
+
+        char ch = *p;
+        *p = 0;
+        expand_pushField(cmd, start);
+        if (!ch) break;
+
+        *p = ch;
+        start = p + 1;
+    }
+}
+
+/**
+ * @brief Push an expanded value into a word buffer
+ * @param out The word buffer
+ * @param str The value
+ * @param length Length of the value
+ * @param flags Expansion flags. Quoted values have their special characters marked.
+ */
+void expand_pushValue(buffer_t *out, const char *str, size_t length, int flags) {
+    int mark = (flags & EXPAND_FLAG_QUOTED) && !(flags & EXPAND_FLAG_RAW);
+
+    for (size_t i = 0; i < length; i++) {
+        if (mark && EXPAND_IS_META(str[i])) buffer_push(out, EXPAND_CTLESC);
+        buffer_push(out, str[i]);
+    }
+}
+
+/**
+ * @brief Get the length of the parameter name at the start of a string
+ * @returns 0 if the string does not start with a parameter name
+ */
+size_t expand_nameLength(const char *str) {
+    if (isdigit((unsigned char)*str)) {
+        size_t len = 0;
+        while (isdigit((unsigned char)str[len])) len++;
+        return len;
+    }
+
+    if (*str && strchr("?$#!@*-", *str)) return 1;
+    if (!isalpha((unsigned char)*str) && *str != '_') return 0;
+
+    size_t len = 1;
+    while (isalnum((unsigned char)str[len]) || str[len] == '_') len++;
+    return len;
+}
+
+/**
+ * @brief Look up a parameter
+ * @param name The parameter name
+ * @param tmp Scratch space for values that have to be formatted
+ * @param tmpsz Size of @c tmp
+ * @returns The value, or NULL if it is unset
+ */
+static const char *expand_lookup(char *name, char *tmp, size_t tmpsz) {
+    if (isdigit((unsigned char)*name)) {
+        int n = atoi(name);
+        if (!n) return essence_argc ? essence_argv[0] : "essence";
+        return (n < essence_argc) ? essence_argv[n] : NULL;
+    }
+
+    if (!name[1]) {
+        switch (*name) {
+            case '$':
+                snprintf(tmp, tmpsz, "%d", essence_pid);
+                return tmp;
+            case '#':
+                snprintf(tmp, tmpsz, "%d", essence_argc ? essence_argc - 1 : 0);
+                return tmp;
+            case '?':
+                snprintf(tmp, tmpsz, "%d", cmd_last_exit_status);
+                return tmp;
+            case '!':
+            case '-':
+                return "";
+        }
+    }
+
+    if (!strcmp(name, "RANDOM")) {
+        snprintf(tmp, tmpsz, "%d", rand() % 32768);
+        return tmp;
+    }
+
+    return variable_get(name);
+}
+
+/**
+ * @brief Expand $@ or $* into a word buffer
+ */
+static void expand_positionals(buffer_t *out, int flags, int star) {
+    for (int i = 1; i < essence_argc; i++) {
+        if (i > 1) buffer_push(out, (star || (flags & EXPAND_FLAG_RAW)) ? ' ' : EXPAND_CTLSPLIT);
+        expand_pushValue(out, essence_argv[i], strlen(essence_argv[i]), flags);
+    }
+}
+
+/**
+ * @brief Expand a named parameter into a word buffer
+ * @param name The parameter name
+ * @param out The word buffer
+ * @param flags Expansion flags
+ */
+void expand_variable(char *name, buffer_t *out, int flags) {
+    if ((*name == '@' || *name == '*') && !name[1]) {
+        expand_positionals(out, flags, *name == '*');
+        return;
+    }
+
+    char tmp[32];
+    const char *value = expand_lookup(name, tmp, sizeof(tmp));
+    if (value) expand_pushValue(out, value, strlen(value), flags);
+}
+
+/**
+ * @brief Expand a single character special parameter ($$, $?, $#, ...)
+ */
+void expand_special(int ch, buffer_t *out, int flags) {
+    char name[2] = { ch, 0 };
+    expand_variable(name, out, flags);
+}
+
+/**
+ * @brief Find the end of a balanced $(...) or ${...} in a string
+ * @param str Pointer to the opening character
+ * @returns Pointer to the closing character, or NULL
+ */
+static char *expand_findClose(char *str) {
+    char open = *str;
+    char close = (open == '(') ? ')' : '}';
+    int depth = 0;
+    int quote = 0;
+
+    for (char *p = str; *p; p++) {
+        if (quote) { if (*p == quote) quote = 0; continue; }
+        if (*p == '\'' || *p == '"') quote = *p;
+        else if (*p == open) depth++;
+        else if (*p == close && !--depth) return p;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Expand a $ reference inside a string
+ * @param p Pointer to the character after the $
+ * @returns Pointer to the first character after the reference
+ */
+static char *expand_dollar(char *p, buffer_t *out, int flags) {
+    if (*p == '{' || *p == '(') {
+        char *close = expand_findClose(p);
+        if (!close) {
+            fprintf(stderr, "essence: unexpected EOF when looking for matching \'%c\'\n", (*p == '(') ? ')' : '}');
+            return p + strlen(p);
+        }
+
+        *close = 0;
+        if (*p == '{') expand_parameter(p + 1, out, flags);
+        else expand_substitution(p + 1, out, flags);
+        *close = (*p == '(') ? ')' : '}';
+        return close + 1;
+    }
+
+    size_t len = expand_nameLength(p);
+    if (!len) {
+        buffer_push(out, '$');
+        return p;
+    }
+
+    // Positional parameters past $9 need braces
+    if (isdigit((unsigned char)*p)) len = 1;
+
+    char saved = p[len];
+    p[len] = 0;
+    expand_variable(p, out, flags);
+    p[len] = saved;
+    return p + len;
+}
+
+/**
+ * @brief Expand parameters, command substitutions and quotes in a string
+ * @param str The string (modified temporarily)
+ * @param out The buffer to expand into
+ * @param flags Expansion flags. Quoted parts are expanded with @c EXPAND_FLAG_QUOTED.
+ */
+void expand_string(char *str, buffer_t *out, int flags) {
+    int dq = 0;
+
+    for (char *p = str; *p; ) {
+        int f = flags | (dq ? EXPAND_FLAG_QUOTED : 0);
+
+        if (*p == '\'' && !dq && !(flags & EXPAND_FLAG_QUOTED)) {
+            char *end = strchr(p + 1, '\'');
+            if (!end) end = p + strlen(p);
+            expand_pushValue(out, p + 1, end - p - 1, flags | EXPAND_FLAG_QUOTED);
+            p = *end ? end + 1 : end;
+            continue;
+        }
+
+        if (*p == '"') {
+            dq = !dq;
+            p++;
+            continue;
+        }
+
+        if (*p == '$') {
+            p = expand_dollar(p + 1, out, f);
+            continue;
+        }
+
+        expand_pushValue(out, p, 1, f);
+        p++;
+    }
+}
+
+/**
+ * @brief Compile the pattern operand of a parameter expansion
+ */
+static pattern_t *expand_compileOperand(char *str) {
+    buffer_t *b = buffer_create(64);
+    expand_string(str, b, 0);
+    pattern_t *pat = pattern_compile(b->buffer, b->bufidx);
+    buffer_destroy(b);
+    return pat;
+}
+
+/**
+ * @brief Remove a matching prefix or suffix from a value
+ * @param suffix Remove a suffix instead of a prefix
+ * @param longest Remove the longest match instead of the shortest
+ */
+static void expand_removePattern(const char *value, char *patstr, int suffix, int longest, buffer_t *out, int flags) {
+    pattern_t *pat = expand_compileOperand(patstr);
+    long len = strlen(value);
+    long start = 0, end = len;
+
+    if (!suffix) {
+        for (long i = longest ? len : 0; longest ? i >= 0 : i <= len; i += longest ? -1 : 1) {
+            if (pattern_match(pat, value, i)) { start = i; break; }
+        }
+    } else {
+        for (long i = longest ? 0 : len; longest ? i <= len : i >= 0; i += longest ? 1 : -1) {
+            if (pattern_match(pat, value + i, len - i)) { end = i; break; }
+        }
+    }
+
+    expand_pushValue(out, value + start, end - start, flags);
+    pattern_destroy(pat);
+}
+
+/**
+ * @brief Replace matches of a pattern in a value
+ * @param mode '/' for the first match, 'a' for all, '#' anchored at the start, '%' anchored at the end
+ */
+static void expand_substitute(const char *value, char *patstr, char *repstr, int mode, buffer_t *out, int flags) {
+    pattern_t *pat = expand_compileOperand(patstr);
+
+    buffer_t *rep = buffer_create(64);
+    if (repstr) expand_string(repstr, rep, EXPAND_FLAG_RAW);
+
+    long len = strlen(value);
+
+    if (mode == '#') {
+        long j;
+        for (j = len; j >= 0 && !pattern_match(pat, value, j); j--);
+        if (j >= 0) {
+            expand_pushValue(out, rep->buffer, rep->bufidx, flags);
+            expand_pushValue(out, value + j, len - j, flags);
+        } else {
+            expand_pushValue(out, value, len, flags);
+        }
+    } else if (mode == '%') {
+        long i;
+        for (i = 0; i <= len && !pattern_match(pat, value + i, len - i); i++);
+        expand_pushValue(out, value, (i <= len) ? i : len, flags);
+        if (i <= len) expand_pushValue(out, rep->buffer, rep->bufidx, flags);
+    } else {
+        long i = 0;
+        while (i < len) {
+            long j;
+            for (j = len - i; j > 0 && !pattern_match(pat, value + i, j); j--);
+
+            if (!j) {
+                expand_pushValue(out, value + i, 1, flags);
+                i++;
+                continue;
+            }
+
+            expand_pushValue(out, rep->buffer, rep->bufidx, flags);
+            i += j;
+
+            if (mode != 'a') {
+                expand_pushValue(out, value + i, len - i, flags);
+                break;
+            }
+        }
+    }
+
+    buffer_destroy(rep);
+    pattern_destroy(pat);
+}
+
+/**
+ * @brief Find the separating '/' of a substitution operand
+ */
+static char *expand_findSlash(char *str) {
+    int quote = 0;
+    for (char *p = str; *p; p++) {
+        if (quote) { if (*p == quote) quote = 0; continue; }
+        if (*p == '\'' || *p == '"') quote = *p;
+        else if (*p == '\\' && p[1]) p++;
+        else if (*p == '/') return p;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Report a bad substitution
+ */
+static int expand_badSubstitution(char *expr) {
+    parser_errorPrefix();
+    fprintf(stderr, "${%s}: bad substitution\n", expr);
+    cmd_last_exit_status = 1;
+    return -1;
+}
+
+/**
+ * @brief Push the separator between two elements of "$@", "$*" or an array
+ * @param star Nonzero for the $* form, which always joins with a space
+ */
+static void expand_separator(buffer_t *out, int flags, int star) {
+    buffer_push(out, (star || (flags & EXPAND_FLAG_RAW)) ? ' ' : EXPAND_CTLSPLIT);
+}
+
+/**
+ * @brief Expand every element of an array
+ * @param v The array (a set scalar counts as one element)
+ * @param star Nonzero for ${a[*]}
+ */
+static void expand_elements(variable_t *v, int star, buffer_t *out, int flags) {
+    if (!v) return;
+
+    if (!v->array) {
+        if (v->value) expand_pushValue(out, v->value, strlen(v->value), flags);
+        return;
+    }
+
+    size_t cursor = 0;
+    variable_element_t *e;
+    for (int first = 1; (e = variable_iterate(v, &cursor)); first = 0) {
+        if (!first) expand_separator(out, flags, star);
+        expand_pushValue(out, e->value, strlen(e->value), flags);
+    }
+}
+
+/**
+ * @brief Expand the subscripts of an array, ${!a[@]}
+ */
+static void expand_keys(variable_t *v, int star, buffer_t *out, int flags) {
+    if (!v) return;
+
+    if (!v->array) {
+        if (v->value) buffer_push(out, '0');
+        return;
+    }
+
+    size_t cursor = 0;
+    variable_element_t *e;
+    for (int first = 1; (e = variable_iterate(v, &cursor)); first = 0) {
+        if (!first) expand_separator(out, flags, star);
+
+        if (e->key) {
+            expand_pushValue(out, e->key, strlen(e->key), flags);
+        } else {
+            char num[32];
+            int len = snprintf(num, sizeof(num), "%lld", e->index);
+            expand_pushValue(out, num, len, flags);
+        }
+    }
+}
+
+/**
+ * @brief Find the closing bracket of a subscript
+ * @param str Pointer to the opening '['
+ */
+static char *expand_findBracket(char *str) {
+    int depth = 0;
+    for (char *p = str; *p; p++) {
+        if (*p == '[') depth++;
+        else if (*p == ']' && !--depth) return p;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Look up an array element
+ * @param name The array name
+ * @param subscript The unexpanded subscript
+ */
+static const char *expand_lookupElement(char *name, char *subscript) {
+    variable_t *v = variable_find(name);
+    if (!v) return NULL;
+
+    buffer_t *key = buffer_create(32);
+    expand_string(subscript, key, EXPAND_FLAG_RAW);
+    const char *value = variable_getElement(v, key->buffer);
+    buffer_destroy(key);
+    return value;
+}
+
+/**
+ * @brief Parse ${name:offset[:length]} bounds and clamp them to a length
+ * @returns 0 on success
+ */
+static int expand_sliceBounds(char *word, long len, long *offset, long *count) {
+    char *end;
+    *offset = strtol(word, &end, 10);
+    *count = len;
+    if (end == word && *end != ':') return -1;
+
+    if (*end == ':') {
+        char *lend;
+        *count = strtol(end + 1, &lend, 10);
+        end = lend;
+    }
+
+    if (*end) return -1;
+
+    if (*offset < 0) *offset = (len + *offset < 0) ? 0 : len + *offset;
+    if (*offset > len) *offset = len;
+    if (*count < 0) *count = (len + *count > *offset) ? len + *count - *offset : 0;
+    if (*offset + *count > len) *count = len - *offset;
+    return 0;
+}
+
+/**
+ * @brief Apply a substring, pattern removal or substitution operator to a value
+ * @returns 0 on success, -1 if the operator is invalid
+ */
+static int expand_operator(const char *value, char opch, char *word, buffer_t *out, int flags) {
+    if (opch == ':') {
+        long offset, count;
+        if (expand_sliceBounds(word, strlen(value), &offset, &count) < 0) return -1;
+        expand_pushValue(out, value + offset, count, flags);
+    } else if (opch == '#' || opch == '%') {
+        int longest = (*word == opch);
+        expand_removePattern(value, word + longest, (opch == '%'), longest, out, flags);
+    } else if (opch == '/') {
+        int mode = '/';
+        if (*word == '/') { mode = 'a'; word++; }
+        else if (*word == '#' || *word == '%') { mode = *word; word++; }
+
+        char *slash = expand_findSlash(word);
+        if (slash) *slash = 0;
+        expand_substitute(value, word, slash ? slash + 1 : NULL, mode, out, flags);
+        if (slash) *slash = '/';
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Expand ${#name}, ${#name[@]} or ${#name[subscript]}
+ * @param expr The expression after the '#'
+ */
+static int expand_length(char *expr, buffer_t *out, int flags) {
+    char tmp[32];
+    size_t len = expand_nameLength(expr);
+    if (!len) return -1;
+
+    char *bracket = expr + len;
+    size_t length = 0;
+
+    if (*bracket == '[') {
+        char *close = expand_findBracket(bracket);
+        if (!close || close[1]) return -1;
+
+        *bracket = 0;
+        *close = 0;
+
+        char *subscript = bracket + 1;
+        if ((*subscript == '@' || *subscript == '*') && !subscript[1]) {
+            variable_t *v = variable_find(expr);
+            length = v ? variable_count(v) : 0;
+        } else {
+            const char *value = expand_lookupElement(expr, subscript);
+            length = value ? strlen(value) : 0;
+        }
+
+        *bracket = '[';
+        *close = ']';
+    } else if (*bracket) {
+        return -1;
+    } else if ((*expr == '@' || *expr == '*') && !expr[1]) {
+        length = essence_argc ? essence_argc - 1 : 0;
+    } else {
+        const char *value = expand_lookup(expr, tmp, sizeof(tmp));
+        length = value ? strlen(value) : 0;
+    }
+
+    char num[32];
+    snprintf(num, sizeof(num), "%zu", length);
+    expand_pushValue(out, num, strlen(num), flags);
+    return 0;
+}
+
+/**
+ * @brief Expand ${!name[@]} (array subscripts) or ${!name} (indirection)
+ * @param expr The expression after the '!'
+ */
+static int expand_indirect(char *expr, buffer_t *out, int flags) {
+    char tmp[32];
+    size_t len = expand_nameLength(expr);
+    if (!len) return -1;
+
+    char *rest = expr + len;
+    if (*rest == '[' && (rest[1] == '@' || rest[1] == '*') && rest[2] == ']' && !rest[3]) {
+        *rest = 0;
+        expand_keys(variable_find(expr), rest[1] == '*', out, flags);
+        *rest = '[';
+        return 0;
+    }
+
+    if (*rest) return -1;
+
+    const char *target = expand_lookup(expr, tmp, sizeof(tmp));
+    if (!target || !*target) return 0;
+    if (!isalpha((unsigned char)*target) && *target != '_' && !isdigit((unsigned char)*target)) return -1;
+
+    char *copy = strdup(target);
+    int ret = expand_parameter(copy, out, flags);
+    free(copy);
+    return ret;
+}
+
+/**
+ * @brief Expand a brace parameter expression
+ * @param expr The expression between ${ and }
+ * @param out The buffer to expand into
+ * @param flags Expansion flags
+ * @returns 0 on success
+ */
+int expand_parameter(char *expr, buffer_t *out, int flags) {
+    char tmp[32];
+
+    if (expr[0] == '#' && expr[1]) {
+        return (expand_length(expr + 1, out, flags) < 0) ? expand_badSubstitution(expr) : 0;
+    }
+
+    if (expr[0] == '!' && expr[1]) {
+        return (expand_indirect(expr + 1, out, flags) < 0) ? expand_badSubstitution(expr) : 0;
+    }
+
+    size_t namelen = expand_nameLength(expr);
+    if (!namelen) return expand_badSubstitution(expr);
+
+    // Split off a subscript
+    char *op = expr + namelen;
+    char *bracket = NULL, *close = NULL;
+    if (*op == '[' && (isalpha((unsigned char)*expr) || *expr == '_')) {
+        close = expand_findBracket(op);
+        if (!close) return expand_badSubstitution(expr);
+
+        bracket = op;
+        *bracket = 0;
+        *close = 0;
+        op = close + 1;
+    }
+
+    char *subscript = bracket ? bracket + 1 : NULL;
+    int all = subscript && (*subscript == '@' || *subscript == '*') && !subscript[1];
+    int star = all && *subscript == '*';
+
+    // Split the name off the operator
+    char opch = *op;
+    *op = 0;
+
+    variable_t *array = all ? variable_find(expr) : NULL;
+    const char *value;
+    if (all) value = (array && variable_count(array)) ? "" : NULL;
+    else if (subscript) value = expand_lookupElement(expr, subscript);
+    else value = expand_lookup(expr, tmp, sizeof(tmp));
+
+    int ret = 0;
+    int bad = 0;
+
+    int colon = (opch == ':');
+    char *word = op + 1;
+    char kind = colon ? *word : opch;
+
+    if (!opch) {
+        if (all) expand_elements(array, star, out, flags);
+        else if (subscript) { if (value) expand_pushValue(out, value, strlen(value), flags); }
+        else expand_variable(expr, out, flags);
+    } else if (kind && strchr("-=?+", kind)) {
+        if (colon) word++;
+
+        int unset = !value;
+        if (colon && value && all) {
+            // A single empty element counts as null
+            size_t cursor = 0;
+            variable_element_t *e = array->array ? variable_iterate(array, &cursor) : NULL;
+            unset = (variable_count(array) == 1 && !*(e ? e->value : array->value));
+        } else if (colon && value) {
+            unset = !*value;
+        }
+
+        switch (kind) {
+            case '-':
+                if (unset) expand_string(word, out, flags);
+                else if (all) expand_elements(array, star, out, flags);
+                else expand_pushValue(out, value, strlen(value), flags);
+                break;
+
+            case '=':
+                if (!unset) {
+                    if (all) expand_elements(array, star, out, flags);
+                    else expand_pushValue(out, value, strlen(value), flags);
+                    break;
+                }
+
+                if (all || (!isalpha((unsigned char)*expr) && *expr != '_')) {
+                    fprintf(stderr, "essence: $%s: cannot assign in this way\n", expr);
+                    ret = -1;
+                    break;
+                }
+
+                buffer_t *assigned = buffer_create(64);
+                expand_string(word, assigned, EXPAND_FLAG_RAW);
+
+                if (subscript) {
+                    buffer_t *key = buffer_create(32);
+                    expand_string(subscript, key, EXPAND_FLAG_RAW);
+                    if (variable_setElement(variable_create(expr), key->buffer, assigned->buffer, 0) < 0) ret = -1;
+                    buffer_destroy(key);
+                } else if (variable_set(expr, assigned->buffer) < 0) {
+                    ret = -1;
+                }
+
+                expand_pushValue(out, assigned->buffer, assigned->bufidx, flags);
+                buffer_destroy(assigned);
+                break;
+
+            case '?':
+                if (!unset) {
+                    if (all) expand_elements(array, star, out, flags);
+                    else expand_pushValue(out, value, strlen(value), flags);
+                    break;
+                }
+
+                buffer_t *msg = buffer_create(64);
+                expand_string(word, msg, EXPAND_FLAG_RAW);
+                parser_errorPrefix();
+                fprintf(stderr, "%s: %s\n", expr, msg->bufidx ? msg->buffer : "parameter null or not set");
+                buffer_destroy(msg);
+
+                cmd_last_exit_status = 1;
+                if (essence_input_type != INPUT_TYPE_INTERACTIVE) exit(1);
+                ret = -1;
+                break;
+
+            case '+':
+                if (!unset) expand_string(word, out, flags);
+                break;
+        }
+    } else if (all && colon) {
+        // ${a[@]:offset:length} slices the element list
+        long offset, count;
+        if (expand_sliceBounds(word, variable_count(array), &offset, &count) < 0) {
+            bad = 1;
+        } else if (!array->array) {
+            if (count) expand_pushValue(out, array->value, strlen(array->value), flags);
+        } else {
+            size_t cursor = 0;
+            long idx = 0;
+            variable_element_t *e;
+            while ((e = variable_iterate(array, &cursor)) && idx < offset + count) {
+                if (idx >= offset) {
+                    if (idx > offset) expand_separator(out, flags, star);
+                    expand_pushValue(out, e->value, strlen(e->value), flags);
+                }
+                idx++;
+            }
+        }
+    } else if (all) {
+        // Apply the operator to each element
+        if (array && !array->array) {
+            bad = expand_operator(array->value ? array->value : "", opch, word, out, flags) < 0;
+        } else if (array) {
+            size_t cursor = 0;
+            variable_element_t *e;
+            for (int first = 1; !bad && (e = variable_iterate(array, &cursor)); first = 0) {
+                if (!first) expand_separator(out, flags, star);
+                bad = expand_operator(e->value, opch, word, out, flags) < 0;
+            }
+        }
+    } else {
+        bad = expand_operator(value ? value : "", opch, word, out, flags) < 0;
+    }
+
+    *op = opch;
+    if (bracket) {
+        *bracket = '[';
+        *close = ']';
+    }
+
+    if (bad) return expand_badSubstitution(expr);
+    return ret;
+}
+
+/**
+ * @brief Run a command and expand its output into a buffer
+ * @param cmd The command to run
+ * @param out The buffer to expand into
+ * @param flags Expansion flags
+ * @returns 0 on success
+ */
+int expand_commandSubstitution(char *cmd, buffer_t *out, int flags) {
+    int pfd[2];
+    if (pipe(pfd) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    fflush(stdout);
+    input_sync();
+
+    pid_t cpid = fork();
+    if (cpid < 0) {
+        perror("fork");
+        close(pfd[0]);
+        close(pfd[1]);
+        return -1;
+    }
+
+    if (!cpid) {
+        // Run the command in a copy of ourselves, which leaves the terminal to the shell
+        cmd_job_control = 0;
+        close(pfd[0]);
+        dup2(pfd[1], STDOUT_FILENO);
+        close(pfd[1]);
+
+        parser_reset();
+        input_loadBuffer(cmd);
+        parser_interpret();
+
+        fflush(stdout);
+        _exit(cmd_last_exit_status);
+    }
+
+    close(pfd[1]);
+
+    size_t start = out->bufidx;
+    char chunk[4096];
+
+    while (1) {
+        ssize_t r = read(pfd[0], chunk, sizeof(chunk));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+        expand_pushValue(out, chunk, r, flags);
+    }
+
+    close(pfd[0]);
+
+    int wstatus = 0;
+    while (waitpid(cpid, &wstatus, 0) < 0 && errno == EINTR);
+
+    // Strip trailing newlines
+    while (out->bufidx > start && out->buffer[out->bufidx-1] == '\n') buffer_pop(out);
+
+    cmd_last_exit_status = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+    return 0;
+}
+
+/**
+ * @brief Evaluate an arithmetic expansion into a buffer
+ * @param expr The expression inside $((...))
+ * @param out The buffer to expand into
+ * @param flags Expansion flags
+ * @returns 0 on success
+ */
+int expand_arithmetic(char *expr, buffer_t *out, int flags) {
+    buffer_t *expanded = buffer_create(64);
+    expand_string(expr, expanded, EXPAND_FLAG_RAW);
+
+    long long result;
+    int ret = arith_evaluate(expanded->buffer, &result);
+    buffer_destroy(expanded);
+
+    if (ret < 0) {
+        cmd_last_exit_status = 1;
+        return -1;
+    }
+
+    char tmp[32];
+    int len = snprintf(tmp, sizeof(tmp), "%lld", result);
+    expand_pushValue(out, tmp, len, flags);
+    return 0;
+}
+
+/**
+ * @brief Expand the body of a $(...), which is arithmetic if it is itself fully parenthesized
+ * @param body The text between the outer parentheses
+ * @param out The buffer to expand into
+ * @param flags Expansion flags
+ * @returns 0 on success
+ */
+int expand_substitution(char *body, buffer_t *out, int flags) {
+    size_t len = strlen(body);
+
+    if (len >= 2 && *body == '(' && expand_findClose(body) == body + len - 1) {
+        body[len - 1] = 0;
+        int ret = expand_arithmetic(body + 1, out, flags);
+        body[len - 1] = ')';
+        return ret;
+    }
+
+    return expand_commandSubstitution(body, out, flags);
+}
+
+/**
+ * @brief Find the end of a word in a compound assignment list
+ */
+static char *expand_listWordEnd(char *p) {
+    int quote = 0;
+
+    for (; *p; p++) {
+        if (quote) {
+            if (*p == quote) quote = 0;
+            continue;
+        }
+
+        if (*p == '\'' || *p == '"') {
+            quote = *p;
+        } else if (*p == '$' && (p[1] == '(' || p[1] == '{')) {
+            char *close = expand_findClose(p + 1);
+            if (close) p = close;
+        } else if (isspace((unsigned char)*p)) {
+            break;
+        }
+    }
+
+    return p;
+}
+
+/**
+ * @brief Assign the words of a NAME=(...) list to an array
+ * @param v The array, already cleared unless this is +=
+ * @param list The raw text between the parentheses, modified temporarily
+ * @returns 0 on success
+ */
+int expand_compoundAssign(variable_t *v, char *list) {
+    long long next = variable_nextIndex(v);
+    int ret = 0;
+
+    for (char *p = list; ; ) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+
+        char *end = expand_listWordEnd(p);
+        char saved = *end;
+        *end = 0;
+
+        char *close = (*p == '[') ? expand_findBracket(p) : NULL;
+        if (close && close[1] == '=') {
+            // [subscript]=value
+            *close = 0;
+
+            buffer_t *key = buffer_create(32);
+            buffer_t *value = buffer_create(64);
+            expand_string(p + 1, key, EXPAND_FLAG_RAW);
+            expand_string(close + 2, value, EXPAND_FLAG_RAW);
+
+            if (v->type == VARIABLE_TYPE_ASSOC) {
+                if (variable_setElement(v, key->buffer, value->buffer, 0) < 0) ret = -1;
+            } else {
+                long long index;
+                if (arith_evaluate(key->buffer, &index) < 0 || variable_setIndex(v, index, value->buffer, 0) < 0) ret = -1;
+                else next = index + 1;
+            }
+
+            buffer_destroy(key);
+            buffer_destroy(value);
+            *close = ']';
+        } else if (v->type == VARIABLE_TYPE_ASSOC) {
+            fprintf(stderr, "essence: %s: %s: must use subscript when assigning associative array\n", v->name, p);
+            ret = -1;
+        } else {
+            // Plain words go through the full word expansion, so one word may become many elements
+            buffer_t *word = buffer_create(64);
+            expand_string(p, word, 0);
+
+            command_t fields;
+            COMMAND_INIT(&fields);
+            expand_pushWord(&fields, word->buffer);
+
+            for (int i = 0; i < fields.argc; i++) {
+                if (variable_setIndex(v, next++, fields.argv[i], 0) < 0) ret = -1;
+            }
+
+            command_cleanup(&fields);
+            buffer_destroy(word);
+        }
+
+        *end = saved;
+        p = end;
+    }
+
+    return ret;
+}
@@ -1,96 +1,824 @@
 /**
  * @file history.c
  * @brief History
- * 
- * 
+ *
+ * Every accepted line is appended to the history file ($HISTFILE, or
+ * ~/.history) as it is accepted, with a "#<time>" line before it, in a
+ * single O_APPEND write. Sessions running at once each add their lines
+ * whole, and nothing is lost if the shell dies.
+ *
+ * Nothing is read at startup. Only the size of the file is noted; the
+ * entries before it are mapped and picked from the end the first time
+ * someone goes back past this session's own lines (or runs history).
+ * Another session may have compacted the file in the meantime, so that
+ * size can end mid-line or past lines added since; entries stamped after
+ * this session started are skipped, as is a line the size cuts.
+ *
+ * In memory the entries are kept in a ring of $HISTSIZE slots, so the
+ * oldest one is dropped in place once it is full. Every line is in it only
+ * once: a hash set of the lines finds an older copy of a line being added,
+ * which is erased (its slot left empty until the ring is next compacted).
+ *
+ * Searches (Ctrl-R, Ctrl-S) go through an index of the three-character
+ * pieces of every line, built the first time one is done and then added
+ * to as lines are. Each piece has the ids of the entries that contain it,
+ * ascending, and ids go up with every entry added, so the entries a query
+ * could be in are walked from the rarest of its pieces towards older or
+ * newer ones, and only those are compared. Erased and dropped entries
+ * stay in the index until they outnumber the rest, then it is rebuilt.
+ *
+ * At exit the file is cut down to the newest $HISTFILESIZE entries. It is
+ * rewritten in place rather than replaced, so the other sessions' append
+ * descriptors stay valid, and under an exclusive flock, which appends and
+ * loads take as well.
+ *
  * @copyright
  * This file is part of the Ethereal Operating System.
  * It is released under the terms of the BSD 3-clause license.
  * Please see the LICENSE file in the main repository for more details.
- * 
+ *
  * Copyright (C) 2025 Samuel Stuart
  */
 
-#include "input.h"
+#include "essence.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-/* History buffer */
-char **history_buffer = NULL;
-size_t history_buffer_size = 0;
-size_t history_buffer_len = 0;
+/* History ring */
+static history_entry_t *history_ring = NULL;
+static size_t history_capacity = 0;         // Slots in it, $HISTSIZE
+static size_t history_head = 0;             // Slot of the oldest entry
+static size_t history_used = 0;             // Slots in use from there, erased ones included
+static size_t history_erased = 0;           // Erased entries among them
+
+/* Lines in the ring, an open-addressing table of slot + 1 (0 if free) */
+static size_t *history_set = NULL;
+static size_t history_set_size = 0;
+static size_t history_set_used = 0;         // Cells not free, deleted ones included
+
+/* Search index, open-addressing by trigram */
+static history_posting_t *history_postings = NULL;
+static size_t history_posting_size = 0;
+static size_t history_posting_count = 0;
+static int history_indexed = 0;             // The index is built
+static size_t history_index_stale = 0;      // Entries in it that are gone from the ring
+static uint32_t history_next_id = 0;        // Id of the next entry added
 
 /* History file */
-FILE *history_file = NULL;
+static char *history_path = NULL;
+static int history_fd = -1;                 // Open for appending
+static off_t history_start = 0;             // Its size when the session started, the entries before are loaded lazily
+static int history_loaded = 0;              // They were loaded (or don't matter anymore)
+static pid_t history_pid = 0;               // The shell that owns it, not the copies forked to run commands
+static time_t history_started = 0;          // When the session started, entries stamped later are not from before it
+
+/**
+ * @brief Get a size limit from a variable
+ * @param name HISTSIZE or HISTFILESIZE
+ * @param fallback Limit if it isn't set to a number
+ */
+static size_t history_limit(const char *name, size_t fallback) {
+    const char *value = variable_get(name);
+    if (!value || !*value) return fallback;
+
+    char *end;
+    long limit = strtol(value, &end, 10);
+    if (*end || limit < 0) return fallback;
+
+    return limit;
+}
+
+/**
+ * @brief Check if a line of the history file is a timestamp
+ */
+static int history_isStamp(const char *line, size_t length) {
+    if (length < 2 || line[0] != '#') return 0;
+
+    for (size_t i = 1; i < length; i++) {
+        if (line[i] < '0' || line[i] > '9') return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Find the start of the line that ends at a position
+ * @param data Start of the file
+ * @param end Just past the newline of the line, or the end of the file
+ */
+static const char *history_lineStart(const char *data, const char *end) {
+    if (end > data && end[-1] == '\n') end--;
+    while (end > data && end[-1] != '\n') end--;
+    return end;
+}
+
+/**
+ * @brief Hash a line
+ */
+static unsigned int history_hash(const char *line, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)line[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
 
 /**
- * @brief Flush history file
+ * @brief Find the slot holding a line
+ * @returns The slot, or -1 if it isn't in the ring
+ */
+static long history_find(const char *line, size_t length, unsigned int hash) {
+    if (!history_set_size) return -1;
+
+    size_t mask = history_set_size - 1;
+    for (size_t i = hash & mask; history_set[i]; i = (i + 1) & mask) {
+        if (history_set[i] == HISTORY_SET_DELETED) continue;
+
+        history_entry_t *entry = &history_ring[history_set[i] - 1];
+        if (entry->hash == hash && !strncmp(entry->line, line, length) && !entry->line[length]) return history_set[i] - 1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Add the line of a slot to the set
+ */
+static void history_setInsert(size_t slot) {
+    size_t mask = history_set_size - 1;
+    size_t i = history_ring[slot].hash & mask;
+    while (history_set[i] && history_set[i] != HISTORY_SET_DELETED) i = (i + 1) & mask;
+
+    if (!history_set[i]) history_set_used++;
+    history_set[i] = slot + 1;
+}
+
+/**
+ * @brief Remove the line of a slot from the set
+ */
+static void history_setRemove(size_t slot) {
+    size_t mask = history_set_size - 1;
+    size_t i = history_ring[slot].hash & mask;
+    while (history_set[i] != slot + 1) i = (i + 1) & mask;
+
+    history_set[i] = HISTORY_SET_DELETED;
+}
+
+/**
+ * @brief Refill the set from the ring, dropping the deleted cells
+ */
+static void history_rebuildSet() {
+    memset(history_set, 0, history_set_size * sizeof(size_t));
+    history_set_used = 0;
+
+    for (size_t i = 0; i < history_used; i++) {
+        size_t slot = (history_head + i) % history_capacity;
+        if (history_ring[slot].line) history_setInsert(slot);
+    }
+}
+
+/**
+ * @brief Move the entries together, leaving out the erased ones
+ */
+static void history_compact() {
+    if (!history_erased) return;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < history_used; i++) {
+        history_entry_t *entry = &history_ring[(history_head + i) % history_capacity];
+        if (entry->line) history_ring[(history_head + kept++) % history_capacity] = *entry;
+    }
+
+    history_used = kept;
+    history_erased = 0;
+    history_rebuildSet();
+}
+
+/**
+ * @brief Give the ring a new number of slots, keeping the newest entries that fit
+ */
+static void history_indexDrop();
+
+static void history_resize(size_t capacity) {
+    history_compact();
+    history_indexDrop();
+
+    history_entry_t *ring = calloc(capacity ? capacity : 1, sizeof(history_entry_t));
+    size_t keep = (history_used < capacity) ? history_used : capacity;
+
+    for (size_t i = 0; i < history_used; i++) {
+        history_entry_t *entry = &history_ring[(history_head + i) % history_capacity];
+        if (i < history_used - keep) free(entry->line);
+        else ring[i - (history_used - keep)] = *entry;
+    }
+
+    free(history_ring);
+    history_ring = ring;
+    history_capacity = capacity;
+    history_head = 0;
+    history_used = keep;
+
+    // At most half full
+    free(history_set);
+    history_set_size = 16;
+    while (history_set_size < capacity * 2) history_set_size *= 2;
+    history_set = calloc(history_set_size, sizeof(size_t));
+    history_rebuildSet();
+}
+
+/**
+ * @brief Make room for one more entry in the ring
+ * @returns 0, or -1 if it has no slots at all
+ */
+static int history_makeRoom() {
+    if (!history_capacity) return -1;
+
+    if (history_used == history_capacity) history_compact();
+
+    // Still full, the oldest entry goes
+    if (history_used == history_capacity) {
+        history_setRemove(history_head);
+        free(history_ring[history_head].line);
+        history_head = (history_head + 1) % history_capacity;
+        history_used--;
+        history_index_stale++;
+    }
+
+    // The deleted cells only go when the set is refilled
+    if ((history_set_used + 1) * 4 > history_set_size * 3) history_rebuildSet();
+
+    return 0;
+}
+
+/**
+ * @brief Find the ids of the entries with a trigram
+ * @param create Add it if there are none
+ * @returns The posting (an empty cell if there are none), or NULL if there is no index
+ */
+static history_posting_t *history_posting(uint32_t trigram, int create) {
+    if (create && (history_posting_count + 1) * 4 > history_posting_size * 3) {
+        history_posting_t *old = history_postings;
+        size_t old_size = history_posting_size;
+
+        history_posting_size = old_size ? old_size * 2 : HISTORY_INITIAL_POSTINGS;
+        history_postings = calloc(history_posting_size, sizeof(history_posting_t));
+
+        for (size_t i = 0; i < old_size; i++) {
+            if (!old[i].trigram) continue;
+            *history_posting(old[i].trigram, 0) = old[i];
+        }
+
+        free(old);
+    }
+
+    if (!history_posting_size) return NULL;
+
+    size_t mask = history_posting_size - 1;
+    size_t i = (trigram * 2654435761u) & mask;
+    while (history_postings[i].trigram && history_postings[i].trigram != trigram) i = (i + 1) & mask;
+
+    history_posting_t *posting = &history_postings[i];
+    if (posting->trigram) return posting;
+    if (!create) return posting;
+
+    posting->trigram = trigram;
+    history_posting_count++;
+    return posting;
+}
+
+/**
+ * @brief Get the trigram at a position of a string
+ */
+static inline uint32_t history_trigram(const char *str) {
+    return ((uint32_t)(unsigned char)str[0] << 16) | ((uint32_t)(unsigned char)str[1] << 8) | (unsigned char)str[2];
+}
+
+/**
+ * @brief Add an entry to the search index, it must be newer than the ones in it
+ */
+static void history_indexAdd(history_entry_t *entry) {
+    size_t length = strlen(entry->line);
+
+    for (size_t i = 0; i + HISTORY_SEARCH_GRAM <= length; i++) {
+        history_posting_t *posting = history_posting(history_trigram(entry->line + i), 1);
+
+        // A trigram that comes up twice in the line
+        if (posting->count && posting->ids[posting->count - 1] == entry->id) continue;
+
+        if (posting->count == posting->size) {
+            posting->size = posting->size ? posting->size * 2 : 4;
+            posting->ids = realloc(posting->ids, posting->size * sizeof(uint32_t));
+        }
+
+        posting->ids[posting->count++] = entry->id;
+    }
+}
+
+/**
+ * @brief Throw the search index away
+ */
+static void history_indexDrop() {
+    if (!history_indexed) return;
+
+    for (size_t i = 0; i < history_posting_size; i++) free(history_postings[i].ids);
+    free(history_postings);
+
+    history_postings = NULL;
+    history_posting_size = 0;
+    history_posting_count = 0;
+    history_indexed = 0;
+}
+
+/**
+ * @brief Build the search index from the entries there are, numbering them again
+ */
+static void history_indexBuild() {
+    history_indexDrop();
+    history_compact();
+
+    history_next_id = 0;
+    for (size_t i = 0; i < history_used; i++) {
+        history_entry_t *entry = &history_ring[(history_head + i) % history_capacity];
+        entry->id = history_next_id++;
+        history_indexAdd(entry);
+    }
+
+    history_indexed = 1;
+    history_index_stale = 0;
+}
+
+/**
+ * @brief Find the position of an entry (from the oldest) by its id
+ * @returns The position, or -1 if it is gone
+ */
+static long history_position(uint32_t id) {
+    size_t lo = 0, hi = history_used;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        uint32_t at = history_ring[(history_head + mid) % history_capacity].id;
+
+        if (at == id) return mid;
+        if (at < id) lo = mid + 1;
+        else hi = mid;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Move a cursor in a posting to the nearest id at or past another, going the way of a search
+ *
+ * It gallops (1, 2, 4, ... ids at a time) and then halves, so a cursor that
+ * moves a long way costs only the logarithm of the distance.
+ *
+ * @param cursor Index in the posting, -1 or the count once past its end
+ * @param id The id
+ * @param backward Going to lower ids: stop at the last id not above it, else the first not below it
+ */
+static void history_seek(history_posting_t *posting, long *cursor, uint32_t id, int backward) {
+    long count = posting->count;
+    long at = *cursor;
+    long step = 1;
+
+    if (!backward) {
+        if (at >= count || posting->ids[at] >= id) return;
+
+        // ids[lo] < id, the answer is in (lo, hi]
+        long lo = at, hi = at + 1;
+        while (hi < count && posting->ids[hi] < id) {
+            lo = hi;
+            step *= 2;
+            hi = lo + step;
+        }
+
+        if (hi > count) hi = count;
+        while (hi - lo > 1) {
+            long mid = lo + (hi - lo) / 2;
+            if (posting->ids[mid] < id) lo = mid;
+            else hi = mid;
+        }
+
+        *cursor = hi;
+    } else {
+        if (at < 0 || posting->ids[at] <= id) return;
+
+        // ids[hi] > id, the answer is in [lo, hi)
+        long hi = at, lo = at - 1;
+        while (lo >= 0 && posting->ids[lo] > id) {
+            hi = lo;
+            step *= 2;
+            lo = hi - step;
+        }
+
+        if (lo < -1) lo = -1;
+        while (hi - lo > 1) {
+            long mid = lo + (hi - lo) / 2;
+            if (posting->ids[mid] > id) hi = mid;
+            else lo = mid;
+        }
+
+        *cursor = lo;
+    }
+}
+
+/**
+ * @brief Add an entry to the ring
+ * @param entry The entry, the ring takes over its line
+ * @param oldest Add it as the oldest entry instead of the newest
+ */
+static void history_push(history_entry_t *entry, int oldest) {
+    if (history_makeRoom() < 0) {
+        free(entry->line);
+        return;
+    }
+
+    size_t slot;
+    if (oldest) {
+        // Ids only go up, older entries are numbered when the index is built
+        history_indexDrop();
+        history_head = (history_head + history_capacity - 1) % history_capacity;
+        slot = history_head;
+    } else {
+        slot = (history_head + history_used) % history_capacity;
+        entry->id = history_next_id++;
+    }
+
+    history_ring[slot] = *entry;
+    history_used++;
+    history_setInsert(slot);
+
+    if (history_indexed && !oldest) history_indexAdd(&history_ring[slot]);
+}
+
+/**
+ * @brief Get the entry some way back from the newest, the erased ones don't count
+ */
+static history_entry_t *history_at(size_t index) {
+    history_compact();
+    if (index >= history_used) return NULL;
+    return &history_ring[(history_head + history_used - index - 1) % history_capacity];
+}
+
+/**
+ * @brief Add an entry from the history file before the ones there are, unless a newer copy is in
+ */
+static void history_loadEntry(const char *line, size_t length, time_t time) {
+    unsigned int hash = history_hash(line, length);
+    if (!length || history_find(line, length, hash) >= 0) return;
+
+    history_entry_t entry = { .line = strndup(line, length), .hash = hash, .time = time };
+    history_push(&entry, 1);
+}
+
+/**
+ * @brief Load the entries from before this session, as many as $HISTSIZE leaves room for
+ */
+static void history_loadFile() {
+    history_loaded = 1;
+    if (!history_path || !history_start) return;
+
+    int fd = open(history_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    // A compaction would cut the file from under the mapping
+    flock(fd, LOCK_SH);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !st.st_size) goto _unlock;
+
+    // Lines appended since the session started are its own, or another one's
+    size_t size = (st.st_size < history_start) ? (size_t)st.st_size : (size_t)history_start;
+    char *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) goto _unlock;
+
+    history_compact();
+
+    // After a compaction the old size may fall inside a line
+    const char *end = map + size;
+    while (end > map && end[-1] != '\n') end--;
+
+    // Newest first, from the end, so only the tail of a long file is touched
+    const char *pending = NULL;         // Entry waiting for its timestamp
+    size_t pending_length = 0;
+    while (end > map && history_used < history_capacity) {
+        const char *line = history_lineStart(map, end);
+        size_t length = end - line;
+        if (length && line[length - 1] == '\n') length--;
+        end = line;
+
+        // The timestamp is the line before its entry, it says if the entry was moved here by a compaction
+        if (history_isStamp(line, length)) {
+            time_t time = strtoll(line + 1, NULL, 10);
+            if (pending && time <= history_started) history_loadEntry(pending, pending_length, time);
+            pending = NULL;
+            continue;
+        }
+
+        if (pending) history_loadEntry(pending, pending_length, 0);
+        pending = line;
+        pending_length = length;
+    }
+
+    if (pending && history_used < history_capacity) history_loadEntry(pending, pending_length, 0);
+
+    munmap(map, size);
+
+_unlock:
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+/**
+ * @brief Append an entry to the history file
+ */
+static void history_write(history_entry_t *entry) {
+    if (history_fd < 0) return;
+
+    size_t size = strlen(entry->line) + 32;
+    char *record = malloc(size);
+    int length = snprintf(record, size, "#%lld\n%s\n", (long long)entry->time, entry->line);
+
+    // In one write, so it can't be split by another session's, and not during a compaction
+    flock(history_fd, LOCK_EX);
+    while (write(history_fd, record, length) < 0 && errno == EINTR);
+    flock(history_fd, LOCK_UN);
+
+    free(record);
+}
+
+/**
+ * @brief Cut the history file down to the newest $HISTFILESIZE entries
  */
 void history_flush() {
+    if (history_fd < 0 || getpid() != history_pid) return;
+
+    close(history_fd);
+    history_fd = -1;
+
+    size_t limit = history_limit("HISTFILESIZE", history_limit("HISTSIZE", HISTORY_DEFAULT_SIZE));
+
+    int fd = open(history_path, O_RDWR | O_CLOEXEC);
+    if (fd < 0) return;
+
+    flock(fd, LOCK_EX);
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !st.st_size) goto _unlock;
 
+    size_t size = st.st_size;
+    char *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) goto _unlock;
+
+    // Count entries from the end, everything before the first one too many goes
+    size_t count = 0;
+    size_t cut = 0;
+    const char *end = map + size;
+    while (end > map) {
+        const char *line = history_lineStart(map, end);
+        size_t length = end - line;
+        if (length && line[length - 1] == '\n') length--;
+
+        if (length && !history_isStamp(line, length) && ++count > limit) {
+            cut = end - map;
+            break;
+        }
+
+        end = line;
+    }
+
+    if (cut) {
+        size_t keep = size - cut;
+        char *tail = malloc(keep ? keep : 1);
+        memcpy(tail, map + cut, keep);
+        munmap(map, size);
+
+        size_t done = 0;
+        while (done < keep) {
+            ssize_t w = pwrite(fd, tail + done, keep - done, done);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) break;
+            done += w;
+        }
+
+        if (done == keep) ftruncate(fd, keep);
+        free(tail);
+    } else {
+        munmap(map, size);
+    }
+
+_unlock:
+    flock(fd, LOCK_UN);
+    close(fd);
 }
 
 /**
  * @brief Load history file
+ *
+ * Only opens it for appending, see history_loadFile() for the rest.
  */
 void history_load() {
+    history_pid = getpid();
+    history_started = time(NULL);
     atexit(history_flush);
 
-    // Open history file
-    char history_path[256];
-    snprintf(history_path, 256, "%s/.history", getenv("HOME"));
-    history_file = fopen(history_path, "r");
+    history_resize(history_limit("HISTSIZE", HISTORY_DEFAULT_SIZE));
+
+    const char *file = variable_get("HISTFILE");
+    const char *home = variable_get("HOME");
+
+    if (file && *file) {
+        history_path = strdup(file);
+    } else if (home) {
+        size_t size = strlen(home) + sizeof(HISTORY_FILE_NAME) + 1;
+        history_path = malloc(size);
+        snprintf(history_path, size, "%s/%s", home, HISTORY_FILE_NAME);
+    } else {
+        return;
+    }
+
+    history_fd = open(history_path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (history_fd < 0) return;
 
-    // Create buffer
-    history_buffer = malloc(12 * sizeof(char*));
-    history_buffer_size = 12;
-    history_buffer_len = 0;
+    struct stat st;
+    if (!fstat(history_fd, &st)) history_start = st.st_size;
 }
 
 /**
  * @brief Get a history entry
- * @param index The index
+ * @param index The index, 0 is the newest
  */
 char *history_get(int index) {
-    if (!history_buffer) return NULL;
-    
-    if (index >= history_buffer_len) {
-        // We must pull from the file
-        if (history_file) {
-            return NULL;
-        }
+    if (!history_ring || index < 0) return NULL;
 
-        return NULL;
+    // Going back past this session's entries needs the older ones
+    history_entry_t *entry = history_at(index);
+    if (!entry && !history_loaded) {
+        history_loadFile();
+        entry = history_at(index);
     }
 
-    return history_buffer[history_buffer_len-(index)-1];
+    return entry ? entry->line : NULL;
 }
 
 /**
  * @brief Append a history entry
  */
 void history_append(char *str) {
-    if (!history_buffer) return;
-    
-    // Temporarily remove newline
-    char *nl = (strchr(str, '\n'));
-    if (nl) *nl = 0;
-
-    // Check, was the previous entry the same?
-    if (history_buffer_len && !strcmp(history_buffer[history_buffer_len-1], str)) {
-        // Yes, don't bother
-        if (nl) *nl = '\n';
-        return;
+    if (!history_ring) return;
+
+    size_t length = strcspn(str, "\n");
+
+    // Blank lines aren't worth keeping
+    if (strspn(str, " \t") >= length) return;
+
+    size_t limit = history_limit("HISTSIZE", HISTORY_DEFAULT_SIZE);
+    if (limit != history_capacity) history_resize(limit);
+
+    // An older copy of the line is erased, the same as the newest entry isn't added at all
+    unsigned int hash = history_hash(str, length);
+    long slot = history_find(str, length, hash);
+    if (slot >= 0) {
+        if ((size_t)slot == (history_head + history_used - 1) % history_capacity) return;
+
+        history_setRemove(slot);
+        free(history_ring[slot].line);
+        history_ring[slot].line = NULL;
+        history_erased++;
+        history_index_stale++;
+    }
+
+    history_entry_t entry = { .line = strndup(str, length), .hash = hash, .time = time(NULL) };
+    history_write(&entry);
+    history_push(&entry, 0);
+}
+
+/**
+ * @brief Get the number of history entries, loading the ones from the file
+ */
+size_t history_count() {
+    if (!history_ring) return 0;
+    if (!history_loaded) history_loadFile();
+
+    history_compact();
+    return history_used;
+}
+
+/**
+ * @brief Get a history entry by number
+ * @param index The index, 0 is the oldest
+ */
+history_entry_t *history_entry(size_t index) {
+    history_compact();
+    if (index >= history_used) return NULL;
+    return history_at(history_used - index - 1);
+}
+
+/**
+ * @brief Forget all history entries, the file keeps them
+ */
+void history_clear() {
+    for (size_t i = 0; i < history_used; i++) free(history_ring[(history_head + i) % history_capacity].line);
+
+    history_head = 0;
+    history_used = 0;
+    history_erased = 0;
+    history_loaded = 1;
+    history_rebuildSet();
+    history_indexDrop();
+}
+
+/**
+ * @brief Find an entry containing some text
+ * @param query The text
+ * @param from Index to start at (0 is the newest), it may be the match itself
+ * @param backward Look at older entries, rather than newer ones
+ * @returns The index of the entry, or -1 if there is none
+ */
+int history_search(const char *query, int from, int backward) {
+    if (!history_ring || from < 0) return -1;
+    if (!history_loaded) history_loadFile();
+
+    if (!history_indexed || history_index_stale > history_used) history_indexBuild();
+    history_compact();
+    if ((size_t)from >= history_used) return -1;
+
+    long start = history_used - from - 1;
+    size_t length = strlen(query);
+
+    // Too short to have a trigram, look at the entries one by one
+    if (length < HISTORY_SEARCH_GRAM) {
+        for (long pos = start; pos >= 0 && pos < (long)history_used; pos += backward ? -1 : 1) {
+            if (strstr(history_ring[(history_head + pos) % history_capacity].line, query)) return history_used - pos - 1;
+        }
+
+        return -1;
     }
-    
-    history_buffer[history_buffer_len] = strdup(str);
-    if (nl) *nl = '\n';
 
-    history_buffer_len++;
+    // Every trigram of the query has to be there
+    size_t count = 0;
+    history_posting_t **postings = malloc((length - HISTORY_SEARCH_GRAM + 1) * sizeof(history_posting_t*));
+    long *cursors = malloc((length - HISTORY_SEARCH_GRAM + 1) * sizeof(long));
+    int result = -1;
+
+    for (size_t i = 0; i + HISTORY_SEARCH_GRAM <= length; i++) {
+        history_posting_t *posting = history_posting(history_trigram(query + i), 0);
+        if (!posting || !posting->trigram) goto _done;
 
-    if (history_buffer_len >= history_buffer_size) {
-        history_buffer = realloc(history_buffer, sizeof(char*) * (history_buffer_size*2));
-        history_buffer_size *= 2;
+        // The same trigram twice only needs looking at once
+        size_t n;
+        for (n = 0; n < count && postings[n] != posting; n++);
+        if (n < count) continue;
+
+        // Rarest first, it moves the others the furthest
+        for (n = count++; n > 0 && postings[n - 1]->count > posting->count; n--) postings[n] = postings[n - 1];
+        postings[n] = posting;
     }
-}
\ No newline at end of file
+
+    for (size_t i = 0; i < count; i++) cursors[i] = backward ? (long)postings[i]->count - 1 : 0;
+
+    // Leapfrog: each posting moves to the candidate or past it, which then becomes the candidate,
+    // until they all agree on one
+    uint32_t candidate = history_ring[(history_head + start) % history_capacity].id;
+    size_t agreed = 0;
+
+    for (size_t i = 0; ; i = (i + 1) % count) {
+        history_posting_t *posting = postings[i];
+        history_seek(posting, &cursors[i], candidate, backward);
+        if (cursors[i] < 0 || cursors[i] >= (long)posting->count) break;
+
+        uint32_t id = posting->ids[cursors[i]];
+        if (id != candidate) {
+            candidate = id;
+            agreed = 1;
+            continue;
+        }
+
+        if (++agreed < count) continue;
+
+        // Still there, and the trigrams are in the right order
+        long pos = history_position(candidate);
+        if (pos >= 0 && strstr(history_ring[(history_head + pos) % history_capacity].line, query)) {
+            result = history_used - pos - 1;
+            break;
+        }
+
+        // On to the next one
+        if (backward && !candidate) break;
+        candidate += backward ? -1 : 1;
+        agreed = 0;
+    }
+
+_done:
+    free(postings);
+    free(cursors);
+    return result;
+}
@@ -20,14 +20,21 @@
 #include <stdlib.h>
 #include <termios.h>
 #include <errno.h>
-#include <time.h>
 #include <sys/time.h>
-#include <pwd.h>
-#include <dirent.h>
 #include <limits.h>
 #include <sys/stat.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <ctype.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 /* Input type */
 int essence_input_type = INPUT_TYPE_INTERACTIVE;
@@ -35,9 +42,6 @@ int essence_input_type = INPUT_TYPE_INTERACTIVE;
 /* Prompt type */
 int essence_prompt = INPUT_PROMPT_PS1;
 
-/* Prompt X */
-int essence_prompt_x = 0;
-
 /* Unread character */
 int essence_unread_character = 0;
 
@@ -47,170 +51,80 @@ size_t input_buffer_size = INPUT_DEFAULT_BUFFER_SIZE;
 size_t input_buffer_idx = 0;
 size_t input_buffer_len = 0;
 
-/* Saved input buffer */
-char *saved_input_buffer = NULL;
+/* Line being edited, and the text killed from it */
+static edit_line_t input_line = { 0 };
+static edit_kill_ring_t input_kill_ring = { 0 };
+
+/* History entry shown (0 is the line being typed), and that line while browsing */
 int history_index = 0;
+static char *input_saved_line = NULL;
+static char *input_last_search = NULL;      // Query of the last history search, Ctrl-R with none typed repeats it
 
 /* Original termios settings */
 static struct termios essence_original_termios;
 static struct termios essence_new_termios;
 static int essence_termios_ready = 0;
 
-/* Input file */
-FILE *input_script = NULL;
+/* Set when input_buffer points into memory we don't own (a script mapping) */
+static int input_buffer_borrowed = 0;
 
-/**
- * @brief Parse PS prompt
- * @param prompt The prompt to parse
- */
-char *input_parsePS(char *prompt) {
-    buffer_t *buf = buffer_create(strlen(prompt));
-    
-    // I used https://ss64.com/bash/syntax-prompt.html as my reference for PS-syntax.
-    char *p = prompt;
-
-    // Get time
-    time_t t;
+/* Buffer handed out at the end of a script */
+static char input_eof_buffer[2] = { EOF, 0 };
 
-    time(&t);
-    struct tm *tm = localtime(&t);
+/* Input script */
+input_script_t *input_script = NULL;
 
-    // Temporary buffer
-    char tmp[128];
+/* Input stream (non-interactive stdin) */
+static input_stream_t *input_stream = NULL;
 
-    while (*p) {
-        if (*p == '\\') {
-            // Next character
-            p++;
+/* Screen update of the current keystroke, written out in one go */
+static buffer_t *input_frame = NULL;
 
-            if (!*p) {
-                buffer_push(buf, '\\');
-                continue;
-            }
+/* Output counters of the line editor, see $EDITSTATS */
+input_edit_stats_t input_edit_stats = { 0 };
 
-            switch (*p) {
-                case 'd':
-                    // Date, in weekday month date
-                    // Get date
-                    strftime(tmp, 128, "%a %B %d", tm);
-
-                    buffer_pushString(buf, tmp);
-                    break;
-
-                case 'h':
-                case 'H':
-                    // Get hostname
-                    gethostname(tmp, 128);
-
-                    // \h is for hostname up to the first .
-                    if (*p == 'h') {
-                        char *dot = strchr(tmp, '.');
-                        if (dot) *tmp = 0;
-                    } 
-
-                    buffer_pushString(buf, tmp);
-                    break;
-
-                case 'j':
-                    // Currently running jobs
-                    buffer_push(buf, '0');
-                    break;
-
-                case 's':
-                    // Name of the shell
-                    buffer_pushString(buf, "essence");
-                    break;
-
-                case 't':
-                    // Time in 24-hour HH:MM:SS format
-                    strftime(tmp, 128, "%H:%M:%S", tm);
-                    buffer_pushString(buf, tmp);
-                    break;
-
-                case 'T':
-                    // Time in 12-hour HH:MM:SS
-                    strftime(tmp, 128, "%I:%M:%S", tm);
-                    buffer_pushString(buf, tmp);
-                    break;
-                
-                case '@':
-                    // Time in 12-hour am/pm format
-                    strftime(tmp, 128, "%I:%M %p", tm);
-                    buffer_pushString(buf, tmp);
-                    break;
-
-                case 'u':
-                    // Username of the current user
-                    struct passwd *p = getpwuid(geteuid());
-
-                    if (p) {
-                        buffer_pushString(buf, p->pw_name);
-                    } else {
-                        buffer_pushString(buf, "This-user-does-not-exist");
-                    }
-
-                    break;
-
-                case '$':
-                    if (!geteuid()) {
-                        buffer_push(buf, '#');
-                    } else {
-                        buffer_push(buf, '$');
-                    }
-
-                    break;
-
-                case 'W': ;
-                    char cwd[256];
-                    getcwd(cwd, 256);
-                    char *s = strrchr(cwd, '/');
-                    if (s) s = s + 1;
-                    if (!s) s = cwd;
-                    if (strlen(cwd) == 1) s = cwd;
-
-                    buffer_pushString(buf, s);
-                    break;
-
-
-                case 'v':
-                case 'V':
-                    // Version
-                    snprintf(tmp, 128, "%d.%d.%d", ESSENCE_VERSION_MAJOR, ESSENCE_VERSION_MINOR, ESSENCE_VERSION_LOWER);;
-                    buffer_pushString(buf, tmp);
-                    break;
-                    
-                case 'e':
-                    buffer_push(buf, '\033');
-                    break;
-
-                case '+':
-                    if (cmd_last_exit_status) {
-                        buffer_pushString(buf, "\033[31m");
-                    } else {
-                        buffer_pushString(buf, "\033[32m");
-                    }
-            }
+/* Keys read from the terminal but not handled yet */
+static char input_keys[INPUT_KEY_CHUNK_SIZE];
+static size_t input_keys_idx = 0;
+static size_t input_keys_len = 0;
 
+/* Pasted lines not handed out yet, one goes to each prompt */
+static buffer_t *input_pending = NULL;
+static size_t input_pending_idx = 0;
 
-        } else {
-            buffer_push(buf, *p);
-        }
+/* Terminal width, read again after a SIGWINCH */
+static size_t input_columns = 80;
+static volatile sig_atomic_t input_resized = 1;
 
-        p++;
-    }
+/* A prompt segment has new output, the prompt is drawn again */
+static int input_prompt_stale = 0;
 
+/* Layout of the prompt, the line is drawn from the end of its last row */
+static size_t input_prompt_width = 0;       // Columns of the last line of the prompt
+static size_t input_prompt_rows = 0;        // Rows of the prompt above its last line
 
-    char *b = buf->buffer;
-    free(buf);
-    return b;
-}
+/* Tab completion, kept while Tab is pressed again and again */
+static char **input_matches = NULL;         // Matches of the word being completed
+static size_t input_match_count = 0;
+static size_t input_match_start = 0;        // Where the completed part of the word starts
+static size_t input_match_index = 0;        // Match put in by cycling, input_match_count if none was
+static int input_match_ranked = 0;          // Matches are fuzzy, best first
+static int input_match_truncated = 0;       // Completion stopped looking, there are more matches
 
+/* What the last frame left on the screen, cells are counted from the start of the prompt's last line */
+static buffer_t *input_shown = NULL;        // The line as it was drawn
+static size_t input_shown_cells = 0;        // Cells it takes
+static size_t input_shown_cursor = 0;       // Cell the terminal cursor is on
 
 /**
  * @brief Get the prompt
+ * @returns The prompt, valid until the next call
  */
-char *input_getPrompt() {
-    char *ps = (essence_prompt == INPUT_PROMPT_PS1) ? getenv("PS1") : getenv("PS2");
+const char *input_getPrompt() {
+    static prompt_t ps1 = { 0 };
+    static prompt_t ps2 = { 0 };
+
+    const char *ps = variable_get((essence_prompt == INPUT_PROMPT_PS1) ? "PS1" : "PS2");
 
     if (!ps) {
         // Handle a fallback since $PS1 and $PS2 are undefined
@@ -226,7 +140,7 @@ char *input_getPrompt() {
         }
     }
 
-    return input_parsePS(ps);
+    return prompt_render((essence_prompt == INPUT_PROMPT_PS1) ? &ps1 : &ps2, ps);
 }
 
 /**
@@ -239,128 +153,779 @@ void input_restoreInteractive() {
 }
 
 /**
- * @brief Redraw cursor
+ * @brief Add text to the frame
  */
-static void input_redrawCursor() {
-    // Thank you tayoky for the cursor code I could steal :D
-    for (int x = essence_prompt_x; x < input_buffer_len; x++) {
-        putchar(input_buffer[x]);
+static void input_frameWrite(const char *data, size_t length) {
+    if (!input_frame) input_frame = buffer_create(INPUT_DEFAULT_BUFFER_SIZE);
+    for (size_t i = 0; i < length; i++) buffer_push(input_frame, data[i]);
+}
+
+/**
+ * @brief Add a string to the frame
+ */
+static void input_frameString(const char *str) {
+    input_frameWrite(str, strlen(str));
+}
+
+/**
+ * @brief Add a character to the frame
+ */
+static void input_frameCharacter(int ch) {
+    char c = ch;
+    input_frameWrite(&c, 1);
+}
+
+/**
+ * @brief Move the cursor from one cell of the line to another
+ *
+ * Cells are counted from the start of the last line of the prompt, so rows
+ * and columns follow from the terminal width.
+ */
+static void input_frameMoveCell(size_t from, size_t to) {
+    char seq[32];
+    size_t from_row = (input_prompt_width + from) / input_columns;
+    size_t from_col = (input_prompt_width + from) % input_columns;
+    size_t to_row = (input_prompt_width + to) / input_columns;
+    size_t to_col = (input_prompt_width + to) % input_columns;
+
+    if (to_row < from_row) input_frameWrite(seq, snprintf(seq, sizeof(seq), "\033[%zuA", from_row - to_row));
+    if (to_row > from_row) input_frameWrite(seq, snprintf(seq, sizeof(seq), "\033[%zuB", to_row - from_row));
+
+    if (to_col == from_col) return;
+    if (!to_col) input_frameCharacter('\r');
+    else if (to_col + 1 == from_col) input_frameCharacter('\b');
+    else input_frameWrite(seq, snprintf(seq, sizeof(seq), "\033[%zuG", to_col + 1));
+}
+
+/**
+ * @brief Put the cursor on a cell that was just written up to
+ *
+ * After writing the last column of a row the cursor stays on it until the
+ * next character arrives, so it is moved to the next row explicitly.
+ */
+static void input_frameWrapped(size_t cell) {
+    size_t position = input_prompt_width + cell;
+    if (position && !(position % input_columns)) input_frameString("\r\n");
+}
+
+/**
+ * @brief Write the frame to the terminal
+ */
+static void input_frameFlush() {
+    if (!input_frame || !input_frame->bufidx) return;
+
+    size_t written = 0;
+    while (written < input_frame->bufidx) {
+        ssize_t r = write(STDOUT_FILENO, input_frame->buffer + written, input_frame->bufidx - written);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
+
+        written += r;
+        input_edit_stats.writes++;
     }
 
-    putchar(' ');
-    putchar('\b');
+    input_edit_stats.bytes += written;
+    input_frame->bufidx = 0;
+    input_frame->buffer[0] = 0;
+}
+
+/**
+ * @brief Read whatever keys are available from the terminal in one go
+ * @returns 1 if some were read, 0 at EOF, -1 if a signal came first
+ */
+static int input_fillKeys() {
+    // While prompt segments run, their output is waited for as well
+    struct pollfd fds[1 + PROMPT_POLL_MAX];
+    int timeout;
+    size_t count;
+
+    while ((count = prompt_pollFds(&fds[1], PROMPT_POLL_MAX, &timeout)) || timeout >= 0) {
+        fds[0].fd = STDIN_FILENO;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+
+        int r = poll(fds, count + 1, timeout);
+        if (r < 0 && errno == EINTR) return -1;
+
+        if (prompt_update()) {
+            input_prompt_stale = 1;
+            return -1;
+        }
 
-    // Now go back...
-    for (int x = essence_prompt_x; x < input_buffer_len; x++) {
-        putchar('\b');
+        if (r > 0 && fds[0].revents) break;
     }
 
-    fflush(stdout);
+    ssize_t r = read(STDIN_FILENO, input_keys, sizeof(input_keys));
+    if (r < 0 && errno == EINTR) return -1;
+    if (r <= 0) return 0;
+
+    input_keys_idx = 0;
+    input_keys_len = r;
+    return 1;
 }
 
-static void add_match(char ***list, size_t *count, size_t *cap, const char *entry) {
-    if (*count + 1 >= *cap) {
-        *cap *= 2;
-        *list = realloc(*list, *cap * sizeof(char*));
+/**
+ * @brief Get the next key from the terminal
+ * @returns The byte, or EOF
+ */
+static int input_readKey() {
+    while (input_keys_idx == input_keys_len) {
+        if (!input_fillKeys()) return EOF;
     }
-    (*list)[(*count)++] = strdup(entry);
+
+    return (unsigned char)input_keys[input_keys_idx++];
 }
 
-char **autocomplete(char *str, bool first_token) {
-    size_t cap = 32, count = 0;
-    char **out = malloc(sizeof(char*) * cap);
-    if (!out) return NULL;
+/**
+ * @brief Note that the terminal was resized (SIGWINCH)
+ */
+static void input_winch(int sig) {
+    (void)sig;
+    input_resized = 1;
+}
 
-    char *input = strdup(str); 
-    char *dir = ".";
-    char *prefix = input;
+/**
+ * @brief Read the terminal width
+ */
+static void input_updateColumns() {
+    struct winsize ws;
+    input_resized = 0;
+    input_columns = (!ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) && ws.ws_col) ? ws.ws_col : 80;
+}
 
-    if (input[0] == '~') {
-        struct passwd *pw = getpwuid(getuid());
-        if (pw) {
-            char tmp[4096];
-            snprintf(tmp, sizeof(tmp), "%s%s", pw->pw_dir, input+1);
-            free(input);
-            input = strdup(tmp);
+/**
+ * @brief Skip an escape sequence
+ * @param p The ESC
+ * @returns The last character of the sequence
+ */
+static const char *input_skipEscape(const char *p) {
+    if (p[1] == '[') {
+        // CSI, ends with a character from @ to ~
+        p += 2;
+        while (*p && (*p < 0x40 || *p > 0x7e)) p++;
+        return *p ? p : p - 1;
+    }
+
+    if (p[1] == ']') {
+        // OSC (e.g. the window title), ends with BEL or ESC backslash
+        p += 2;
+        while (*p && *p != '\a' && !(*p == '\033' && p[1] == '\\')) p++;
+        if (*p == '\033') p++;
+        return *p ? p : p - 1;
+    }
+
+    return p[1] ? p + 1 : p;
+}
+
+/**
+ * @brief Print a prompt and work out where it leaves the cursor
+ *
+ * Text between \[ and \] and escape sequences take no room on the screen.
+ */
+static void input_printPrompt(const char *prompt) {
+    size_t width = 0;
+    size_t rows = 0;
+    int hidden = 0;
+
+    for (const char *p = prompt; *p; p++) {
+        unsigned char c = *p;
+        if (c == INPUT_PROMPT_HIDE_START || c == INPUT_PROMPT_HIDE_END) {
+            hidden = (c == INPUT_PROMPT_HIDE_START);
+            continue;
+        }
+
+        input_frameCharacter(c);
+        if (hidden) continue;
+
+        if (c == '\033') {
+            const char *end = input_skipEscape(p);
+            input_frameWrite(p + 1, end - p);
+            p = end;
+        } else if (c == '\n') {
+            rows += width ? (width - 1) / input_columns + 1 : 1;
+            width = 0;
+        } else if (c == '\r') {
+            width -= width % input_columns;
+        } else if (c >= ' ' && (c & 0xc0) != 0x80) {
+            width++;
+        }
+    }
+
+    input_prompt_width = width;
+    input_prompt_rows = rows;
+
+    // Nothing of the line is on the screen yet
+    if (!input_shown) input_shown = buffer_create(INPUT_DEFAULT_BUFFER_SIZE);
+    input_shown->bufidx = 0;
+    input_shown_cells = 0;
+    input_shown_cursor = 0;
+    input_frameWrapped(0);
+}
+
+/**
+ * @brief Get the length of the character at the start of some cell text
+ */
+static size_t input_cellLength(const char *p, size_t left) {
+    size_t n = 1;
+    while (n < left && (p[n] & 0xc0) == 0x80) n++;
+    return n;
+}
+
+/**
+ * @brief Lay the line out the way it looks on the screen, control characters are shown as ^X
+ * @param out The text of the cells
+ * @param cells Output number of cells
+ * @returns The cell the cursor is on
+ */
+static size_t input_layout(buffer_t *out, size_t *cells) {
+    size_t length = EDIT_LENGTH(&input_line);
+    size_t cursor = EDIT_CURSOR(&input_line);
+    size_t cursor_cell = 0;
+
+    out->bufidx = 0;
+    *cells = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        if (i == cursor) cursor_cell = *cells;
+
+        int c = edit_at(&input_line, i);
+        if (c < ' ' || c == 0x7f) {
+            buffer_push(out, '^');
+            buffer_push(out, c ^ 0x40);
+            *cells += 2;
+        } else {
+            buffer_push(out, c);
+            if ((c & 0xc0) != 0x80) (*cells)++;
+        }
+    }
+
+    return (cursor == length) ? *cells : cursor_cell;
+}
+
+/**
+ * @brief Bring the screen up to date with the line, writing only the cells that changed
+ */
+static void input_refresh() {
+    static buffer_t *layout = NULL;
+    if (!layout) layout = buffer_create(INPUT_DEFAULT_BUFFER_SIZE);
+
+    size_t cells;
+    size_t cursor = input_layout(layout, &cells);
+
+    const char *new = layout->buffer;
+    const char *old = input_shown->buffer;
+    size_t new_length = layout->bufidx;
+    size_t old_length = input_shown->bufidx;
+
+    // The unchanged start of the line, backed up to the start of a character
+    size_t first = 0;
+    while (first < new_length && first < old_length && new[first] == old[first]) first++;
+    while (first && (new[first] & 0xc0) == 0x80) first--;
+
+    size_t first_cell = 0;
+    for (size_t i = 0; i < first; i++) {
+        if ((new[i] & 0xc0) != 0x80) first_cell++;
+    }
+
+    // The last cell that differs from what is at the same place on the screen
+    size_t last_cell = 0, last_end = 0;
+    int changed = 0;
+    for (size_t n = first, o = first, cell = first_cell; n < new_length; cell++) {
+        size_t nl = input_cellLength(new + n, new_length - n);
+        size_t ol = (o < old_length) ? input_cellLength(old + o, old_length - o) : 0;
+
+        if (nl != ol || memcmp(new + n, old + o, nl)) {
+            changed = 1;
+            last_cell = cell;
+            last_end = n + nl;
         }
+
+        n += nl;
+        o += ol;
     }
 
-    char *slash = strrchr(input, '/');
-    if (slash) {
-        *slash = '\0';
-        dir = (*input ? input : "/");
-        prefix = slash + 1;
+    size_t at = input_shown_cursor;
+    if (changed) {
+        input_frameMoveCell(at, first_cell);
+        input_frameWrite(new + first, last_end - first);
+        at = last_cell + 1;
+        input_frameWrapped(at);
     }
 
-    size_t prelen = strlen(prefix);
+    // The line got shorter, clear what was left of it
+    if (input_shown_cells > cells) {
+        input_frameMoveCell(at, cells);
+        input_frameString("\033[J");
+        at = cells;
+    }
 
-    DIR *d = opendir(dir);
-    if (d) {
-        struct dirent *e;
-        while ((e = readdir(d)) != NULL) {
-            if (e->d_name[0] == '.') continue;
-            if (strncmp(e->d_name, prefix, prelen) == 0) {
-                char full[4096];
-                snprintf(full, sizeof(full), "%s/%s", dir, e->d_name);
+    input_frameMoveCell(at, cursor);
 
-                struct stat st;
-                if (stat(full, &st) == 0) {
-                    char formatted[4096];
-                    if (S_ISDIR(st.st_mode)) {
-                        snprintf(formatted, sizeof(formatted), "%s/", e->d_name);
-                    } else {
-                        snprintf(formatted, sizeof(formatted), "%s", e->d_name);
-                    }
+    // What is on the screen now
+    buffer_t *swap = input_shown;
+    input_shown = layout;
+    layout = swap;
+    input_shown_cells = cells;
+    input_shown_cursor = cursor;
+}
 
-                    add_match(&out, &count, &cap, formatted);
-                }
+/**
+ * @brief Draw the prompt and line again from scratch, e.g. after the terminal was resized
+ * @param prompt The prompt
+ * @param columns The terminal width the screen was drawn with
+ */
+static void input_redraw(const char *prompt, size_t columns) {
+    // Back to the first row of the prompt
+    size_t row = (input_prompt_width + input_shown_cursor) / columns + input_prompt_rows;
+
+    char seq[32];
+    if (row) input_frameWrite(seq, snprintf(seq, sizeof(seq), "\033[%zuA", row));
+    input_frameString("\r\033[J");
+
+    input_printPrompt(prompt);
+    input_refresh();
+}
+
+/**
+ * @brief Move below the line, e.g. to print something or run it
+ */
+static void input_leaveLine() {
+    input_frameMoveCell(input_shown_cursor, input_shown_cells);
+
+    // A line that fills its last row already left the cursor on the next one
+    size_t position = input_prompt_width + input_shown_cells;
+    if (!position || position % input_columns) input_frameCharacter('\n');
+}
+
+/**
+ * @brief Move part of the line to the kill ring
+ * @param how How it joins the last kill (EDIT_KILL_*)
+ */
+static void input_kill(size_t from, size_t to, int how) {
+    if (from >= to) return;
+
+    edit_kill(&input_kill_ring, edit_copy(&input_line, from, to), how);
+    edit_erase(&input_line, from, to);
+}
+
+/**
+ * @brief Queue lines to be handed out as input at the next prompts
+ */
+static void input_queue(const char *text, size_t length) {
+    if (!input_pending) input_pending = buffer_create(length + 1);
+    for (size_t i = 0; i < length; i++) buffer_push(input_pending, text[i]);
+}
+
+/**
+ * @brief Read a bracketed paste, after its start sequence
+ *
+ * The first line is inserted at the cursor in one go. If there are more, the
+ * rest are queued for the next prompts rather than run while the paste is
+ * still arriving (and possibly read by the command instead of the shell).
+ *
+ * @returns 1 if the paste ended the current line
+ */
+static int input_paste() {
+    static const char end[] = INPUT_PASTE_END;
+    buffer_t *paste = buffer_create(INPUT_DEFAULT_BUFFER_SIZE);
+    size_t matched = 0;
+
+    while (1) {
+        int ch = input_readKey();
+        if (ch == EOF) break;
+
+        if (ch == end[matched]) {
+            if (++matched == sizeof(end) - 1) break;
+            continue;
+        }
+
+        // A partial match was part of the paste after all
+        if (matched) {
+            for (size_t i = 0; i < matched; i++) buffer_push(paste, end[i]);
+            matched = (ch == end[0]);
+            if (matched) continue;
+        }
+
+        if (!ch) continue;
+        buffer_push(paste, (ch == '\r') ? '\n' : ch);
+    }
+
+    char *nl = memchr(paste->buffer, '\n', paste->bufidx);
+    size_t first = nl ? (size_t)(nl - paste->buffer) : paste->bufidx;
+
+    edit_insert(&input_line, paste->buffer, first);
+    if (nl) input_queue(nl + 1, paste->bufidx - first - 1);
+
+    buffer_destroy(paste);
+    return nl != NULL;
+}
+
+/**
+ * @brief List completion matches in columns below the line, then start the line again underneath
+ */
+static void input_listMatches(const char *prompt) {
+    size_t width = 0;
+    for (size_t i = 0; i < input_match_count; i++) {
+        size_t length = strlen(input_matches[i]);
+        if (length > width) width = length;
+    }
+
+    // Down the columns first, like ls
+    size_t columns = input_columns / (width + 2);
+    if (!columns) columns = 1;
+    size_t rows = (input_match_count + columns - 1) / columns;
+
+    input_leaveLine();
+    for (size_t row = 0; row < rows; row++) {
+        for (size_t column = 0; column < columns; column++) {
+            size_t i = column * rows + row;
+            if (i >= input_match_count) break;
+
+            input_frameString(input_matches[i]);
+            if (i + rows < input_match_count) {
+                for (size_t pad = strlen(input_matches[i]); pad < width + 2; pad++) input_frameCharacter(' ');
             }
         }
-        closedir(d);
-
-        if (!first_token) {
-            out[count] = NULL;
-            free(input);
-            return out;
-        }
-    }
-
-    if (!slash) {
-        char *env = getenv("PATH");
-        if (env) {
-            char *paths = strdup(env);
-            char *pd = strtok(paths, ":");
-            while (pd) {
-                DIR *p = opendir(pd);
-                if (p) {
-                    struct dirent *e;
-                    while ((e = readdir(p)) != NULL) {
-                        if (e->d_name[0] == '.') continue;
-                        if (strncmp(e->d_name, prefix, prelen) == 0) {
-                            char full[4096];
-                            snprintf(full, sizeof(full), "%s/%s", pd, e->d_name);
-
-                            struct stat st;
-                            if (stat(full, &st) == 0 && (st.st_mode & S_IXUSR)) {
-                                add_match(&out, &count, &cap, e->d_name);
-                            }
-                        }
-                    }
-                    closedir(p);
+
+        input_frameCharacter('\n');
+    }
+
+    if (input_match_truncated) {
+        char note[64];
+        snprintf(note, sizeof(note), "(incomplete, only the first %zu matches)\n", input_match_count);
+        input_frameString(note);
+    }
+
+    input_printPrompt(prompt);
+}
+
+/**
+ * @brief Complete the word before the cursor
+ *
+ * The first Tab puts in the only match, or what all the matches share (the
+ * best one if they are fuzzy, in place of the word). The second lists them and the ones after that put them in one by one
+ * (Shift-Tab goes backwards). They all use the matches of the first. When
+ * there were too many to find them all, nothing shared is put in and the
+ * listing says so.
+ *
+ * @param prompt The prompt, for after a listing
+ * @param tabs Number of Tabs in a row, including this one
+ * @param backward Shift-Tab
+ * @returns Number of Tabs in a row to count from next time
+ */
+static int input_complete(const char *prompt, int tabs, int backward) {
+    size_t cursor = EDIT_CURSOR(&input_line);
+
+    if (tabs == 1) {
+        char *before = edit_copy(&input_line, 0, cursor);
+
+        size_t start = cursor;
+        while (start > 0 && before[start-1] != ' ') start--;
+
+        // Arguments are completed the way the command's spec says, if it has one
+        char *command = NULL;
+        if (start > 0) {
+            size_t length = strcspn(before, " ");
+            command = strndup(before, length);
+        }
+
+        input_matches = complete_word(&before[start], command, &input_match_count, &input_match_ranked, &input_match_truncated);
+        free(command);
+        input_match_index = input_match_count;
+
+        // Only the last path component is put in
+        input_match_start = cursor;
+        while (input_match_start > start && before[input_match_start-1] != '/') input_match_start--;
+
+        free(before);
+    }
+
+    if (!input_match_count) {
+        input_frameCharacter('\a');
+        return 0;
+    }
+
+    if (tabs == 1 && !backward && input_match_ranked) {
+        input_match_index = 0;
+        edit_erase(&input_line, input_match_start, cursor);
+        edit_insert(&input_line, input_matches[0], strlen(input_matches[0]));
+
+        if (input_match_count == 1) {
+            if (input_matches[0][strlen(input_matches[0]) - 1] != '/') edit_insert(&input_line, " ", 1);
+            return 0;
+        }
+
+        return 1;
+    }
+
+    // What the matches found share says nothing about the ones that weren't
+    if (tabs == 1 && !backward && input_match_truncated) {
+        input_frameCharacter('\a');
+        return 1;
+    }
+
+    if (tabs == 1 && !backward) {
+        // What all the matches start with
+        size_t shared = strlen(input_matches[0]);
+        for (size_t i = 1; i < input_match_count; i++) {
+            size_t n = 0;
+            while (n < shared && input_matches[i][n] == input_matches[0][n]) n++;
+            shared = n;
+        }
+
+        // Skip what was typed already
+        char *typed = edit_copy(&input_line, input_match_start, cursor);
+        size_t common = 0;
+        while (common < shared && typed[common] && typed[common] == input_matches[0][common]) common++;
+        free(typed);
+
+        if (common < shared) edit_insert(&input_line, input_matches[0] + common, shared - common);
+
+        if (input_match_count == 1) {
+            // Done, the next Tab completes something else
+            if (input_matches[0][shared - 1] != '/') edit_insert(&input_line, " ", 1);
+            return 0;
+        }
+
+        if (common == shared) input_frameCharacter('\a');
+        return 1;
+    }
+
+    if (tabs == 2 && !backward) {
+        input_listMatches(prompt);
+        return 2;
+    }
+
+    // Put the next match in place of the last one
+    if (input_match_index == input_match_count) input_match_index = backward ? input_match_count - 1 : 0;
+    else input_match_index = (input_match_index + (backward ? input_match_count - 1 : 1)) % input_match_count;
+
+    edit_erase(&input_line, input_match_start, cursor);
+    edit_insert(&input_line, input_matches[input_match_index], strlen(input_matches[input_match_index]));
+    return tabs;
+}
+
+/**
+ * @brief Finish the line being edited
+ * @returns The line
+ */
+static char *input_acceptLine() {
+    input_refresh();
+    input_leaveLine();
+
+    // Commands get the terminal back without bracketed paste
+    input_frameString(INPUT_PASTE_OFF);
+    input_frameFlush();
+
+    // The parser gets a plain string, moving the gap out of the way makes the text contiguous
+    size_t length = EDIT_LENGTH(&input_line);
+    edit_moveTo(&input_line, length);
+
+    input_buffer = malloc(length + 2);
+    memcpy(input_buffer, input_line.data, length);
+    input_buffer[length++] = '\n';
+    input_buffer[length] = 0;
+    input_buffer_len = length;
+    input_buffer_size = length + 1;
+    input_buffer_idx = 0;
+
+    history_append(input_buffer);
+    complete_remember(input_buffer);
+
+    free(input_saved_line);
+    input_saved_line = NULL;
+
+    return input_buffer;
+}
+
+/**
+ * @brief Read the rest of an escape sequence, after the ESC
+ * @returns One of INPUT_KEY_*
+ */
+static int input_readEscape() {
+    int ch = input_readKey();
+
+    if (ch == '[' || ch == 'O') {
+        // CSI or SS3: optional numbers separated by ';', then the final character
+        int params[2] = { 0, 0 };
+        int n = 0;
+
+        int final = input_readKey();
+        while (isdigit(final) || final == ';') {
+            if (final == ';') n = 1;
+            else params[n] = params[n] * 10 + final - '0';
+            final = input_readKey();
+        }
+
+        // Alt (3) or Ctrl (5) with an arrow moves by words
+        int word = (params[1] == 3 || params[1] == 5);
+
+        switch (final) {
+            case 'A': return INPUT_KEY_UP;
+            case 'B': return INPUT_KEY_DOWN;
+            case 'C': return word ? INPUT_KEY_WORD_RIGHT : INPUT_KEY_RIGHT;
+            case 'D': return word ? INPUT_KEY_WORD_LEFT : INPUT_KEY_LEFT;
+            case 'H': return INPUT_KEY_HOME;
+            case 'F': return INPUT_KEY_END;
+            case 'Z': return INPUT_KEY_BACK_TAB;
+            case '~':
+                switch (params[0]) {
+                    case 1: case 7: return INPUT_KEY_HOME;
+                    case 4: case 8: return INPUT_KEY_END;
+                    case 3: return INPUT_KEY_DELETE;
+                    case 200: return INPUT_KEY_PASTE;
                 }
-                pd = strtok(NULL, ":");
-            }
-            free(paths);
+                break;
         }
+
+        return INPUT_KEY_NONE;
     }
 
-    out[count] = NULL;
-    free(input);
-    return out;
+    // Alt (meta) keys
+    switch (ch) {
+        case 'b': return INPUT_KEY_WORD_LEFT;
+        case 'f': return INPUT_KEY_WORD_RIGHT;
+        case 'd': return INPUT_KEY_KILL_WORD;
+        case 'y': return INPUT_KEY_YANK_POP;
+        case '\b':
+        case 0x7f: return INPUT_KEY_RUBOUT_WORD;
+    }
+
+    // Not a sequence we know, the key after the ESC is handled on its own
+    if (ch != EOF) input_keys_idx--;
+    return INPUT_KEY_NONE;
 }
 
+/**
+ * @brief Wait for the next key
+ * @returns The key (INPUT_KEY_* for escape sequences, '\b' for erase), or -1 if the wait was interrupted
+ */
+static int input_waitKey() {
+    if (input_keys_idx == input_keys_len) {
+        int r = input_fillKeys();
+        if (r < 0) return -1;
+
+        // The terminal is gone
+        if (!r) exit(cmd_last_exit_status);
+    }
+
+    int ch = input_readKey();
+    input_edit_stats.keystrokes++;
+
+    int key = (ch == '\033') ? input_readEscape() : ch;
+    if (key == (int)essence_original_termios.c_cc[VERASE] || key == 0x7f) key = '\b';
+    return key;
+}
+
+/**
+ * @brief Search the history as the text to find is typed (Ctrl-R older entries, Ctrl-S newer ones)
+ *
+ * The match is put on the line, with the cursor where the text is in it.
+ * Ctrl-R and Ctrl-S go on to the next match, Ctrl-G puts the line back as
+ * it was, and any other key leaves the match on the line for the editor.
+ *
+ * @param prompt The prompt, shown again afterwards
+ * @param key The key that started it
+ * @returns The key that ended it, INPUT_KEY_NONE if that needs nothing more
+ */
+static int input_search(const char *prompt, int key) {
+    char *original = edit_copy(&input_line, 0, EDIT_LENGTH(&input_line));
+    size_t original_cursor = EDIT_CURSOR(&input_line);
+
+    buffer_t *query = buffer_create(64);
+    buffer_t *search_prompt = buffer_create(128);
+
+    // From the entry being looked at, if any
+    int backward = (key == INPUT_CTRL('R'));
+    int start = history_index ? history_index - 1 : 0;
+    int from = backward ? start : start - 1;
+    int match = -1;
+    int failed = 0;
+
+    while (1) {
+        search_prompt->bufidx = 0;
+        if (failed) buffer_append(search_prompt, "(failed ", 8);
+        else buffer_push(search_prompt, '(');
+        buffer_pushString(search_prompt, backward ? "reverse-i-search)`" : "i-search)`");
+        buffer_append(search_prompt, query->buffer, query->bufidx);
+        buffer_append(search_prompt, "': ", 3);
+
+        size_t columns = input_columns;
+        if (input_resized) input_updateColumns();
+        input_redraw(search_prompt->buffer, columns);
+        input_frameFlush();
+
+        key = input_waitKey();
+        if (key < 0) continue;
+
+        if (key == INPUT_CTRL('R') || key == INPUT_CTRL('S')) {
+            backward = (key == INPUT_CTRL('R'));
+            if (!query->bufidx && input_last_search) buffer_pushString(query, input_last_search);
+            if (match >= 0) from = backward ? match + 1 : match - 1;
+        } else if (key == '\b') {
+            // Shorter text may match nearer, start over
+            buffer_pop(query);
+            from = backward ? start : start - 1;
+            failed = 0;
+        } else if (key == INPUT_CTRL('G')) {
+            edit_set(&input_line, original, strlen(original));
+            edit_moveTo(&input_line, original_cursor);
+            match = -1;
+            key = INPUT_KEY_NONE;
+            break;
+        } else if (key >= ' ' && key < INPUT_KEY_NONE) {
+            // Longer text can't match where the shorter one didn't
+            buffer_push(query, key);
+            if (failed) continue;
+            if (match >= 0) from = match;
+        } else {
+            break;
+        }
+
+        if (!query->bufidx) {
+            match = -1;
+            edit_set(&input_line, original, strlen(original));
+            edit_moveTo(&input_line, original_cursor);
+            continue;
+        }
+
+        int found = history_search(query->buffer, from, backward);
+        if (found < 0) {
+            failed = 1;
+            input_frameCharacter('\a');
+            continue;
+        }
+
+        const char *line = history_get(found);
+        failed = 0;
+        match = found;
+        edit_set(&input_line, line, strlen(line));
+        edit_moveTo(&input_line, strstr(line, query->buffer) - line);
+    }
+
+    // Going up and down goes on from the match
+    if (match >= 0) {
+        if (!history_index) input_saved_line = original;
+        else free(original);
+        history_index = match + 1;
+    } else {
+        free(original);
+    }
+
+    if (query->bufidx) {
+        free(input_last_search);
+        input_last_search = strdup(query->buffer);
+    }
+
+    buffer_destroy(query);
+    buffer_destroy(search_prompt);
+
+    size_t columns = input_columns;
+    if (input_resized) input_updateColumns();
+    input_redraw(prompt, columns);
+    return key;
+}
 
- 
 /**
  * @brief Get input (from stdin)
  * @param prompt Optional prompt to use
@@ -371,362 +936,514 @@ char *input_getInteractive(char *user_prompt) {
         tcgetattr(STDIN_FILENO, &essence_new_termios);
 
         essence_new_termios.c_lflag &= ~(ECHO | ICANON);
+
+        // Ctrl-S searches forward instead of stopping the output
+        essence_new_termios.c_iflag &= ~IXON;
         atexit(input_restoreInteractive);
 
+        // Not restarted, so a resize interrupts the wait for a key and the line is redrawn at once
+        struct sigaction sa = { .sa_handler = input_winch };
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGWINCH, &sa, NULL);
+
         tcsetattr(STDIN_FILENO, TCSANOW, &essence_new_termios);
 
+        // The editor writes whole frames itself, this is for builtins writing before a fork
         setvbuf(stdout, NULL, _IONBF, 0);
 
+        edit_init(&input_line);
         essence_termios_ready = 1;
     }
 
-    // Get the prompt
-    char *prompt = user_prompt ? user_prompt : input_getPrompt();
-    size_t prompt_length = strlen(prompt);
+    // Get the prompt, with whatever prompt segments finished while the last command ran
+    prompt_next();
+    prompt_update();
+    input_prompt_stale = 0;
+    const char *prompt = user_prompt ? user_prompt : input_getPrompt();
 
     // Print the prompt out
-    printf("%s", prompt);
-    fflush(stdout);
+    if (input_resized) input_updateColumns();
+    input_frameString(INPUT_PASTE_ON);
+    input_printPrompt(prompt);
 
     // Get some characters
     int bksp = (int)essence_original_termios.c_cc[VERASE];
 
-    // Reset input buffer + friends
+    // Reset input buffer + friends, the edit line keeps its memory
     input_unloadBuffer();
-    input_buffer = malloc(INPUT_DEFAULT_BUFFER_SIZE);
-    input_buffer_size = INPUT_DEFAULT_BUFFER_SIZE;
-
-    // Clear input buffer
-    memset(input_buffer, 0, 512);
+    edit_clear(&input_line);
+
+    int tabs = 0;
+    int last_was_kill = 0;
+    int last_was_yank = 0;
+    size_t yank_start = 0;
+
+    // Lines left over from a paste come first, as if they were typed
+    if (input_pending) {
+        char *text = input_pending->buffer + input_pending_idx;
+        size_t left = input_pending->bufidx - input_pending_idx;
+        char *nl = memchr(text, '\n', left);
+        size_t length = nl ? (size_t)(nl - text) : left;
+
+        edit_insert(&input_line, text, length);
+        input_pending_idx += length + (nl ? 1 : 0);
+
+        if (input_pending_idx >= input_pending->bufidx) {
+            buffer_destroy(input_pending);
+            input_pending = NULL;
+            input_pending_idx = 0;
+        }
 
-    int last_was_tab = 0;
+        if (nl) return input_acceptLine();
+    }
 
     // Enter main loop
     while (1) {
-        int ch = getchar();
-        if (ch != '\t') last_was_tab = 0;
+        // Everything the last keystroke changed goes out in one write
+        input_refresh();
+        input_frameFlush();
+
+        // The terminal was resized or a prompt segment finished
+        if (input_resized || input_prompt_stale) {
+            size_t columns = input_columns;
+            if (input_resized) input_updateColumns();
+            if (input_prompt_stale && !user_prompt) prompt = input_getPrompt();
+
+            input_prompt_stale = 0;
+            input_redraw(prompt, columns);
+            continue;
+        }
 
-        // Handle ANSI arrow keys
-        if (ch == '\033') {
-            // Get next character
-            int next_ch = getchar();
+        int key = input_waitKey();
+        if (key < 0) continue;
 
-            if (next_ch != '[') {
-                // Invalid ANSI escape sequence
-                ungetc(next_ch, stdin);
-                continue;
-            }
+        // Consecutive kills collect into one kill ring entry, yank-pop only follows a yank
+        int was_kill = last_was_kill;
+        int was_yank = last_was_yank;
+        if (key != '\t' && key != INPUT_KEY_BACK_TAB) tabs = 0;
+        last_was_kill = 0;
+        last_was_yank = 0;
 
-            // Valid ANSI sequence, of what?
-            next_ch = getchar();
-            switch (next_ch) {
-                case 'D':
-                    // Left arrow key
-                    if (essence_prompt_x) {
-                        putchar('\b');
-                        fflush(stdout);
+        // A search takes keys until one it has no use for, which then does what it always does
+        if (key == INPUT_CTRL('R') || key == INPUT_CTRL('S')) key = input_search(prompt, key);
 
-                        essence_prompt_x--;
-                    } else {
-                        putchar('\a'); // Bell
-                    }
+        size_t cursor = EDIT_CURSOR(&input_line);
+        size_t length = EDIT_LENGTH(&input_line);
 
-                    continue;
+        switch (key) {
+            case '\n':
+                // We are at the end of the file/line
+                return input_acceptLine();
 
-                case 'C':
-                    if (essence_prompt_x < strlen(input_buffer)) {
-                        putchar(input_buffer[essence_prompt_x]);
-                        fflush(stdout);
+            case INPUT_KEY_PASTE:
+                if (input_paste()) return input_acceptLine();
+                break;
 
-                        essence_prompt_x++;
-                    }
+            case INPUT_KEY_LEFT:
+            case INPUT_CTRL('B'):
+                if (cursor) edit_moveTo(&input_line, cursor - 1);
+                else input_frameCharacter('\a'); // Bell
+                break;
 
-                    continue;
+            case INPUT_KEY_RIGHT:
+            case INPUT_CTRL('F'):
+                if (cursor < length) edit_moveTo(&input_line, cursor + 1);
+                break;
 
-                case 'A':
-                    char *h = history_get(history_index);
-                    if (!h) continue;
+            case INPUT_KEY_HOME:
+            case INPUT_CTRL('A'):
+                edit_moveTo(&input_line, 0);
+                break;
 
-                    if (!history_index) {
-                        saved_input_buffer = input_buffer;
-                    }
+            case INPUT_KEY_END:
+            case INPUT_CTRL('E'):
+                edit_moveTo(&input_line, length);
+                break;
 
-                    // Calculate space difference
-                    int diff = strlen(input_buffer) - strlen(h);
+            case INPUT_KEY_WORD_LEFT:
+                edit_moveTo(&input_line, edit_wordLeft(&input_line, cursor, 0));
+                break;
 
-                    // Free old buffer if needed
-                    if (history_index) free(input_buffer);
+            case INPUT_KEY_WORD_RIGHT:
+                edit_moveTo(&input_line, edit_wordRight(&input_line, cursor));
+                break;
 
-                    input_buffer = malloc(INPUT_DEFAULT_BUFFER_SIZE);
-                    strcpy(input_buffer, h);
+            case '\b':
+                // Backspace character, can we even go back?
+                if (cursor) edit_erase(&input_line, cursor - 1, cursor);
+                break;
 
-                    history_index++;
+            case INPUT_CTRL('D'):
+                // On an empty line this is the end of input
+                if (!length) {
+                    input_leaveLine();
+                    input_frameString(INPUT_PASTE_OFF);
+                    input_frameFlush();
+                    exit(cmd_last_exit_status);
+                }
+
+                // fall through
+            case INPUT_KEY_DELETE:
+                if (cursor < length) edit_erase(&input_line, cursor, cursor + 1);
+                break;
 
-                    essence_prompt_x = strlen(h);
-                    input_buffer_len = strlen(h);
-                    input_buffer_size = strlen(h);
+            case INPUT_CTRL('K'):
+                input_kill(cursor, length, was_kill ? EDIT_KILL_APPEND : EDIT_KILL_NEW);
+                last_was_kill = 1;
+                break;
 
-                    printf("\033[G%s%s", prompt, input_buffer);
+            case INPUT_CTRL('U'):
+                input_kill(0, cursor, was_kill ? EDIT_KILL_PREPEND : EDIT_KILL_NEW);
+                last_was_kill = 1;
+                break;
 
-                    if (diff) {
-                        for (int i = 0; i < diff; i++) putchar(' ');
-                        for (int i = 0; i < diff; i++) putchar('\b');
-                    }
+            case INPUT_CTRL('W'):
+                input_kill(edit_wordLeft(&input_line, cursor, 1), cursor, was_kill ? EDIT_KILL_PREPEND : EDIT_KILL_NEW);
+                last_was_kill = 1;
+                break;
 
-                    fflush(stdout);
-                    
-                    continue;
-                
-                case 'B':
-                    if (!history_index) {
-                        continue;
-                    }
+            case INPUT_KEY_RUBOUT_WORD:
+                input_kill(edit_wordLeft(&input_line, cursor, 0), cursor, was_kill ? EDIT_KILL_PREPEND : EDIT_KILL_NEW);
+                last_was_kill = 1;
+                break;
 
-                    // Free old input buffer, lower index
-                    char *old = input_buffer;
-                    history_index--;
+            case INPUT_KEY_KILL_WORD:
+                input_kill(cursor, edit_wordRight(&input_line, cursor), was_kill ? EDIT_KILL_APPEND : EDIT_KILL_NEW);
+                last_was_kill = 1;
+                break;
 
-                    // Restore saved
-                    if (!history_index) {
-                        input_buffer = saved_input_buffer;
-                        saved_input_buffer = NULL;
-                    } else {
-                        input_buffer = malloc(INPUT_DEFAULT_BUFFER_SIZE);
-                        strcpy(input_buffer, history_get(history_index));
-                    }
+            case INPUT_CTRL('Y'):
+            case INPUT_KEY_YANK_POP: {
+                // Yank-pop swaps the text just yanked for an older kill
+                const char *text;
+                if (key == INPUT_KEY_YANK_POP) {
+                    if (!was_yank) break;
+                    text = edit_yankPop(&input_kill_ring);
+                    edit_erase(&input_line, yank_start, cursor);
+                } else {
+                    text = edit_yank(&input_kill_ring);
+                    yank_start = cursor;
+                }
 
-                    // Calculate space
-                    diff = strlen(old) - strlen(input_buffer);
-                    free(old);
+                if (!text) break;
+                edit_insert(&input_line, text, strlen(text));
+                last_was_yank = 1;
+                break;
+            }
 
-                    
-                    essence_prompt_x = strlen(input_buffer);
-                    input_buffer_len = strlen(input_buffer);
+            case INPUT_KEY_UP: {
+                const char *h = history_get(history_index);
+                if (!h) break;
 
-                    printf("\033[G%s%s", prompt, input_buffer);
+                // Keep what was being typed to come back to
+                if (!history_index) input_saved_line = edit_copy(&input_line, 0, length);
+                history_index++;
 
-                    if (diff) {
-                        for (int i = 0; i < diff; i++) putchar(' ');
-                        for (int i = 0; i < diff; i++) putchar('\b');
-                    }
+                edit_set(&input_line, h, strlen(h));
+                break;
+            }
 
-                    fflush(stdout);
-                    
-                    continue;
+            case INPUT_KEY_DOWN: {
+                if (!history_index) break;
+                history_index--;
 
+                if (history_index) {
+                    const char *h = history_get(history_index - 1);
+                    edit_set(&input_line, h, strlen(h));
+                } else {
+                    edit_set(&input_line, input_saved_line, strlen(input_saved_line));
+                    free(input_saved_line);
+                    input_saved_line = NULL;
+                }
 
-                    
+                break;
             }
-        }
-
-        if (ch == bksp) {
-            // Backspace character, can we even go back?
-            if (essence_prompt_x) {
-                essence_prompt_x--;
 
-                // Put character back in the bfufer
-                memmove(&input_buffer[essence_prompt_x], &input_buffer[essence_prompt_x+1], input_buffer_len-essence_prompt_x);
-                
-                // Backspace
-                putchar('\b');
-                putchar(' ');
-                putchar('\b');
+            case '\t':
+            case INPUT_KEY_BACK_TAB:
+                tabs = input_complete(prompt, tabs + 1, key == INPUT_KEY_BACK_TAB);
+                break;
 
-                input_buffer_len--;
+            default: {
+                // Other control characters and unknown sequences do nothing
+                if (key < ' ' || key >= INPUT_KEY_NONE) break;
+
+                // Whatever printable text was typed along with it goes in at once
+                size_t start = input_keys_idx - 1;
+                size_t end = input_keys_idx;
+                while (end < input_keys_len) {
+                    unsigned char c = input_keys[end];
+                    if (c < ' ' || c == 0x7f || c == bksp) break;
+                    end++;
+                }
 
-                // Redraw
-                input_redrawCursor();
+                edit_insert(&input_line, &input_keys[start], end - start);
+                input_keys_idx = end;
+                break;
             }
-
-            continue;
         }
+    }
+}
 
-        // What character is it
-        switch (ch) {
-            case '\n':
-                // We are at the end of the file/line
-                putchar('\n');
+/**
+ * @brief Get a line of input from the loaded script
+ *
+ * Lines are handed out in place from the script contents, so no line is
+ * copied or split. Only a final line without a newline gets its own copy.
+ */
+char *input_getScript() {
+    input_unloadBuffer();
 
-                input_buffer[input_buffer_len++] = '\n';
+    input_script_t *script = input_script;
+    if (!script || script->offset >= script->length) {
+        input_buffer = input_eof_buffer;
+        input_buffer_len = 1;
+        input_buffer_borrowed = 1;
+        return input_buffer;
+    }
 
-                // Do we need to enlarge the buffer?
-                if (input_buffer_len >= input_buffer_size) {
-                    input_buffer = realloc(input_buffer, input_buffer_size * 2);
-                    input_buffer_size *= 2;
-                }
+    char *line = script->data + script->offset;
+    size_t remaining = script->length - script->offset;
+    char *nl = memchr(line, '\n', remaining);
+    size_t length = nl ? (size_t)(nl - line) + 1 : remaining;
 
-                input_buffer[input_buffer_len] = 0;
+    script->offset += length;
+    script->line++;
 
-                essence_prompt_x = 0;
+    if (nl) {
+        input_buffer = line;
+        input_buffer_borrowed = 1;
+    } else {
+        input_buffer = malloc(length + 2);
+        memcpy(input_buffer, line, length);
+        input_buffer[length++] = '\n';
+        input_buffer[length] = 0;
+    }
 
-                if (input_buffer_len) history_append(input_buffer);
-                if (saved_input_buffer) free(saved_input_buffer);
-                if (prompt && !user_prompt) free(prompt); 
+    input_buffer_len = length;
+    input_buffer_size = length;
+    return input_buffer;
+}
 
-                return input_buffer;
-        
-            case '\t':
-                // Tab for auto completion
-                // Find the last token (after the last space)
+/**
+ * @brief Read exactly @c length bytes
+ * @returns 0 on success
+ */
+static int input_readFully(int fd, char *buf, size_t length) {
+    while (length) {
+        ssize_t r = read(fd, buf, length);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return -1;
+
+        buf += r;
+        length -= r;
+    }
 
-                // Temporarily null-terminate the token to pass to autocomplete
-                char saved = input_buffer[essence_prompt_x];
-                input_buffer[essence_prompt_x] = 0;
-                
-                // find start of last token (after last space or '/') 
-                char *last_token = NULL;
-                size_t start = essence_prompt_x;
-                while (start > 0 && input_buffer[start-1] != ' ') start--;
-                last_token = &input_buffer[start];
+    return 0;
+}
 
-                char **s = autocomplete(last_token, (start == 0));
-                input_buffer[essence_prompt_x] = saved; // restore original char
+/**
+ * @brief Get a line from a seekable stream
+ *
+ * Input is read in large blocks. Whatever has been read but not handed out
+ * is given back with lseek() by @c input_sync before a command runs.
+ *
+ * @returns The length of the line (in the window), 0 on EOF
+ */
+static size_t input_streamSeek(input_stream_t *st, char **line) {
+    while (1) {
+        char *nl = memchr(st->window + st->start, '\n', st->end - st->start);
+        if (nl) {
+            *line = st->window + st->start;
+            size_t length = nl - *line + 1;
+            st->start += length;
+            return length;
+        }
 
-                if (*(s+1) == NULL) {
-                    char *res = *s;
+        // Not a whole line yet, make room and read more
+        if (st->start) {
+            memmove(st->window, st->window + st->start, st->end - st->start);
+            st->end -= st->start;
+            st->start = 0;
+        }
 
-                    // find start
-                    size_t start = essence_prompt_x;
-                    while (start > 0 && input_buffer[start-1] != ' ' && input_buffer[start-1] != '/') start--;
+        if (st->end == st->window_size) {
+            st->window_size *= 2;
+            st->window = realloc(st->window, st->window_size);
+        }
 
-                    size_t typed_len = essence_prompt_x - start; 
+        ssize_t r = read(st->fd, st->window + st->end, st->window_size - st->end);
+        if (r < 0 && errno == EINTR) continue;
 
-                    // compare
-                    size_t common = 0;
-                    while (res[common] && common < typed_len && res[common] == input_buffer[start + common]) common++;
+        if (r <= 0) {
+            if (st->start == st->end) return 0;
 
-                    const char *suffix = res + common; 
+            // Terminate the final line
+            st->window[st->end++] = '\n';
+            continue;
+        }
 
-                    int trail = !(res[strlen(res)-1] == '/');
-                    size_t insert_len = strlen(suffix) + trail; // account for space
+        st->end += r;
+    }
+}
 
-                    while (input_buffer_len + insert_len + 1 >= input_buffer_size) {
-                        input_buffer_size *= 2;
-                        input_buffer = realloc(input_buffer, input_buffer_size);
-                    }
+/**
+ * @brief Make sure the line buffer can hold @c length bytes
+ */
+static void input_streamReserve(input_stream_t *st, size_t length) {
+    if (length <= st->line_size) return;
 
-                    memmove(&input_buffer[essence_prompt_x + insert_len], &input_buffer[essence_prompt_x], input_buffer_len - essence_prompt_x + 1);
+    while (st->line_size < length) st->line_size *= 2;
+    st->line = realloc(st->line, st->line_size);
+}
 
-                    if (trail != 0) {
-                        memcpy(&input_buffer[essence_prompt_x], suffix, insert_len-1);
-                        input_buffer[essence_prompt_x + insert_len-1] = ' ';  // trailing space
-                    } else {
-                        memcpy(&input_buffer[essence_prompt_x], suffix, insert_len);
-                    }
+/**
+ * @brief Get a line from a pipe or other unseekable stream
+ *
+ * Pipes are peeked with tee(), which leaves the data in the pipe, and then
+ * exactly one line is consumed with read(). Anything else is read a byte
+ * at a time. Either way, nothing past the current line is ever consumed.
+ *
+ * @returns The length of the line (in the line buffer), 0 on EOF
+ */
+static size_t input_streamLine(input_stream_t *st) {
+    size_t length = 0;
 
-                    input_buffer_len += insert_len;
-                    essence_prompt_x  += insert_len;
+    while (1) {
+#ifdef __linux__
+        if (st->mode == INPUT_STREAM_PEEK && st->start == st->end) {
+            // Peek at what is waiting without consuming it
+            long n = syscall(SYS_tee, st->fd, st->peek_pipe[1], INPUT_PEEK_SIZE, 0);
+            if (n < 0 && errno == EINTR) continue;
+
+            if (n < 0) {
+                st->mode = INPUT_STREAM_BYTE;
+                continue;
+            }
 
-                    for (size_t i = essence_prompt_x - insert_len; i < input_buffer_len; i++)
-                        putchar(input_buffer[i]);
+            if (!n) break;
 
-                    for (size_t i = 0; i < input_buffer_len - essence_prompt_x; i++)
-                        putchar('\b');
+            if (input_readFully(st->peek_pipe[0], st->window, n) < 0) {
+                st->mode = INPUT_STREAM_BYTE;
+                continue;
+            }
 
-                    fflush(stdout);
-                } else {
-                    if (last_was_tab) {
-                        printf("\n");
-                        char **p = s;
-                        while (*p) {
-                            printf("%s%s", *p, *(p+1) ? ", " : "");
-                            p++;
-                        }
-
-                        input_buffer[essence_prompt_x] = saved;
-                        printf("\n");
-                        printf("%s", prompt);
-
-                        if (input_buffer_len) {
-
-                            for (int x = 0; x < input_buffer_len; x++) {
-                                putchar(input_buffer[x]);
-                            }
-
-                            for (int x = essence_prompt_x; x < input_buffer_len - 1; x++) {
-                                putchar('\b');
-                            }
-                        }
-                        fflush(stdout);
-                        last_was_tab = 0;
-                    } else {
-                        last_was_tab = 1;
-                    }
-                };
-
-                char **p = s;
-                while (*p) { free(*p); p++; }
-                free(s);
+            st->start = 0;
+            st->end = n;
+        }
+#endif
 
-                break;
+        if (st->mode == INPUT_STREAM_PEEK) {
+            char *p = st->window + st->start;
+            size_t avail = st->end - st->start;
+            char *nl = memchr(p, '\n', avail);
+            size_t take = nl ? (size_t)(nl - p) + 1 : avail;
 
-            default:
-                // Check if we need to enlarge the buffer first
-                if (input_buffer_len + 1 >= input_buffer_size) {
-                    char *new_buffer = realloc(input_buffer, input_buffer_size * 2);
-                    if (!new_buffer) {
-                        perror("realloc failed");
-                        exit(1);
-                    }
-                    input_buffer = new_buffer;
-                    input_buffer_size *= 2;
-                }
+            // Consume exactly what was peeked (up to the newline)
+            input_streamReserve(st, length + take + 2);
+            if (input_readFully(st->fd, st->line + length, take) < 0) break;
 
-                // Shift characters to the right to make space for new character
-                memmove(&input_buffer[essence_prompt_x + 1],
-                        &input_buffer[essence_prompt_x],
-                        input_buffer_len - essence_prompt_x);
+            length += take;
+            st->start += take;
+            if (nl) break;
+            continue;
+        }
 
-                // Insert the new character
-                input_buffer[essence_prompt_x] = ch;
-                input_buffer_len++;
+        char ch;
+        ssize_t r = read(st->fd, &ch, 1);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) break;
 
-                // Print the characters from cursor position to the end
-                for (int x = essence_prompt_x; x < input_buffer_len; x++) {
-                    putchar(input_buffer[x]);
-                }
+        input_streamReserve(st, length + 3);
+        st->line[length++] = ch;
+        if (ch == '\n') break;
+    }
 
-                // Move cursor back to the correct position
-                for (int x = essence_prompt_x + 1; x < input_buffer_len; x++) {
-                    putchar('\b');
-                }
+    if (length && st->line[length - 1] != '\n') st->line[length++] = '\n';
+    if (length) st->line[length] = 0;
+    return length;
+}
 
-                essence_prompt_x++;
+/**
+ * @brief Get a line of input from the stream
+ */
+char *input_getStream() {
+    input_unloadBuffer();
 
-                // Null-terminate the string
-                input_buffer[input_buffer_len] = '\0';
-                break;
+    input_stream_t *st = input_stream;
+    char *line = NULL;
+    size_t length = 0;
+
+    if (st) {
+        if (st->mode == INPUT_STREAM_SEEK) {
+            length = input_streamSeek(st, &line);
+        } else {
+            length = input_streamLine(st);
+            line = st->line;
         }
     }
+
+    if (!length) {
+        input_buffer = input_eof_buffer;
+        input_buffer_len = 1;
+        input_buffer_borrowed = 1;
+        return input_buffer;
+    }
+
+    st->line_number++;
+    input_buffer = line;
+    input_buffer_len = length;
+    input_buffer_size = length;
+    input_buffer_borrowed = 1;
+    return input_buffer;
 }
 
 /**
- * @brief Get a input from a file
+ * @brief Read commands from a non-interactive file descriptor
+ * @param fd The file descriptor (usually stdin)
+ * @returns 0 on success
  */
-char *input_getScript() {
-    // Setup input buffer
-    if (input_buffer) free(input_buffer);
-    input_buffer = malloc(INPUT_DEFAULT_BUFFER_SIZE);
-    input_buffer_size = INPUT_DEFAULT_BUFFER_SIZE;
-    input_buffer_idx = 0;
-    input_buffer_len = 0;
-    input_buffer[0] = 0;
+int input_loadStream(int fd) {
+    input_unloadBuffer();
 
-    // Read from the file
-    char *p = fgets(input_buffer, input_buffer_size, input_script);
-    if (!p) {
-        input_buffer_len = 1;
-        input_buffer[0] = EOF;
-    } else {
-        input_buffer_len = strlen(input_buffer);
+    input_stream_t *st = calloc(1, sizeof(input_stream_t));
+    st->fd = fd;
+    st->mode = INPUT_STREAM_BYTE;
+    st->peek_pipe[0] = st->peek_pipe[1] = -1;
+
+    struct stat sb;
+    if (!fstat(fd, &sb)) {
+        if (S_ISREG(sb.st_mode) && lseek(fd, 0, SEEK_CUR) >= 0) {
+            st->mode = INPUT_STREAM_SEEK;
+        }
+#ifdef __linux__
+        else if (S_ISFIFO(sb.st_mode) && !pipe(st->peek_pipe)) {
+            st->mode = INPUT_STREAM_PEEK;
+        }
+#endif
     }
 
-    // restore.. \n?
-    input_buffer[input_buffer_len] = '\n';
-    input_buffer[input_buffer_len+1] = 0;
+    st->window_size = (st->mode == INPUT_STREAM_SEEK) ? INPUT_READ_CHUNK_SIZE : INPUT_PEEK_SIZE;
+    st->window = malloc(st->window_size);
+    st->line_size = INPUT_DEFAULT_BUFFER_SIZE;
+    st->line = malloc(st->line_size);
 
-    // Send input buffer
-    return input_buffer;
+    input_stream = st;
+    essence_input_type = INPUT_TYPE_STREAM;
+    return 0;
+}
+
+/**
+ * @brief Give back any input that was read ahead, before something else reads the stream
+ */
+void input_sync() {
+    input_stream_t *st = input_stream;
+    if (essence_input_type != INPUT_TYPE_STREAM || !st || st->start == st->end) return;
+
+    if (st->mode == INPUT_STREAM_SEEK) lseek(st->fd, -(off_t)(st->end - st->start), SEEK_CUR);
+
+    // Peeked input is still in the pipe, but may not be by the time we look again
+    st->start = st->end = 0;
 }
 
 /**
@@ -739,6 +1456,8 @@ char *input_get(char *user_prompt) {
             return input_getInteractive(user_prompt);
         case INPUT_TYPE_SCRIPT:
             return input_getScript();
+        case INPUT_TYPE_STREAM:
+            return input_getStream();
         default:
             printf("ERROR: Unknown input type %d\n", essence_input_type);
             return NULL;
@@ -756,7 +1475,7 @@ int input_getCharacter() {
     }
 
     if (!input_buffer) return 0;
-    if (input_buffer_idx > input_buffer_len) return 0;
+    if (input_buffer_idx >= input_buffer_len) return 0;
 
     return input_buffer[input_buffer_idx++];    
 }
@@ -779,6 +1498,40 @@ void input_init() {
     }
 }
 
+/**
+ * @brief Get the line editor output so far for $EDITSTATS: keystrokes, bytes written and write() calls
+ * @param buffer Output buffer
+ * @param size Size of the buffer
+ */
+void input_editStats(char *buffer, size_t size) {
+    snprintf(buffer, size, "%zu %zu %zu", input_edit_stats.keystrokes, input_edit_stats.bytes, input_edit_stats.writes);
+}
+
+/**
+ * @brief Read the whole of a file that can't be mapped (pipes, FIFOs)
+ * @returns 0 on success
+ */
+static int input_readScript(int fd, input_script_t *script) {
+    size_t size = INPUT_READ_CHUNK_SIZE;
+    script->data = malloc(size);
+    script->length = 0;
+
+    while (1) {
+        if (script->length == size) {
+            size *= 2;
+            script->data = realloc(script->data, size);
+        }
+
+        ssize_t r = read(fd, script->data + script->length, size - script->length);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) return -1;
+        if (!r) break;
+        script->length += r;
+    }
+
+    return 0;
+}
+
 /**
  * @brief Load a script for input
  * @param filename The script filename to load
@@ -786,27 +1539,170 @@ void input_init() {
  */
 int input_loadScript(char *filename) {
     input_unloadBuffer();
+    input_unloadScript();
 
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "essence: %s: %s\n", filename, strerror(errno));
+        return 1;
+    }
 
+    input_script_t *script = calloc(1, sizeof(input_script_t));
+    script->name = strdup(filename);
+
+    // Map regular files, anything else is read in one go
+    struct stat st;
+    if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+        // Private and writable: compiled scripts are expanded in place, which briefly modifies the text
+        void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            script->data = map;
+            script->length = st.st_size;
+            script->map_length = st.st_size;
+        }
+    }
 
-    input_script = fopen(filename, "r");
-    if (!input_script) {
+    if (!script->data && input_readScript(fd, script) < 0) {
         fprintf(stderr, "essence: %s: %s\n", filename, strerror(errno));
+        close(fd);
+        input_script = script;
+        input_unloadScript();
         return 1;
     }
 
+    close(fd);
+
     // Load script
+    input_script = script;
     essence_input_type = INPUT_TYPE_SCRIPT;
     return 0;
 }
 
+/**
+ * @brief Unload the current script
+ */
+void input_unloadScript() {
+    if (!input_script) return;
+
+    // The current line may point into the script
+    if (input_buffer_borrowed) input_unloadBuffer();
+
+    if (input_script->map_length) munmap(input_script->data, input_script->map_length);
+    else if (!input_script->borrowed) free(input_script->data);
+
+    free(input_script->name);
+    free(input_script);
+    input_script = NULL;
+}
+
+/**
+ * @brief Get the line number of the current script line
+ * @returns The line number, or 0 when not running a script
+ */
+int input_getLine() {
+    if (essence_input_type == INPUT_TYPE_SCRIPT && input_script) return input_script->line;
+    if (essence_input_type == INPUT_TYPE_STREAM && input_stream) return input_stream->line_number;
+    return 0;
+}
+
+/**
+ * @brief Get the column of the last character read from the current line
+ * @returns The column, counting from 1 (0 at the start of a line)
+ */
+int input_getColumn() {
+    if (!input_buffer) return 0;
+    return (int)input_buffer_idx - (essence_unread_character ? 1 : 0);
+}
+
+/**
+ * @brief Set the line number of the current script (for precompiled scripts)
+ * @param line The source line
+ */
+void input_setLine(int line) {
+    if (essence_input_type == INPUT_TYPE_SCRIPT && input_script) input_script->line = line;
+}
+
+/**
+ * @brief Get the name of the current script
+ * @returns The script name, or NULL when not running a script
+ */
+const char *input_getName() {
+    return (essence_input_type == INPUT_TYPE_SCRIPT && input_script) ? input_script->name : NULL;
+}
+
 /**
  * @brief Switch to interactive
  */
 void input_switchInteractive() {
+    input_unloadScript();
     essence_input_type = INPUT_TYPE_INTERACTIVE;
 }
 
+/**
+ * @brief Read commands from a string, in place
+ * @param name The name to use in error messages
+ * @param string The commands (must outlive the input)
+ * @returns 0 on success
+ */
+int input_loadString(const char *name, char *string) {
+    input_unloadBuffer();
+    input_unloadScript();
+
+    input_script_t *script = calloc(1, sizeof(input_script_t));
+    script->name = strdup(name);
+    script->data = string;
+    script->length = strlen(string);
+    script->borrowed = 1;
+
+    input_script = script;
+    essence_input_type = INPUT_TYPE_SCRIPT;
+    return 0;
+}
+
+/**
+ * @brief Set the current input aside, e.g. to read another script in the middle of a line
+ * @param state Where to keep the input until @c input_restore
+ */
+void input_save(input_state_t *state) {
+    state->buffer = input_buffer;
+    state->buffer_idx = input_buffer_idx;
+    state->buffer_len = input_buffer_len;
+    state->buffer_size = input_buffer_size;
+    state->borrowed = input_buffer_borrowed;
+    state->unread = essence_unread_character;
+    state->unget_token = lexer_unget;
+    state->type = essence_input_type;
+    state->script = input_script;
+
+    // Detach it so loading something else doesn't free it
+    input_buffer = NULL;
+    input_buffer_idx = input_buffer_len = 0;
+    input_buffer_borrowed = 0;
+    essence_unread_character = 0;
+    lexer_unget = NULL;
+    input_script = NULL;
+}
+
+/**
+ * @brief Go back to input set aside with @c input_save, dropping whatever was loaded since
+ * @param state The saved input
+ */
+void input_restore(input_state_t *state) {
+    input_unloadBuffer();
+    input_unloadScript();
+    lexer_ungetToken(NULL);
+
+    input_buffer = state->buffer;
+    input_buffer_idx = state->buffer_idx;
+    input_buffer_len = state->buffer_len;
+    input_buffer_size = state->buffer_size;
+    input_buffer_borrowed = state->borrowed;
+    essence_unread_character = state->unread;
+    lexer_unget = state->unget_token;
+    essence_input_type = state->type;
+    input_script = state->script;
+}
+
 /**
  * @brief Load buffer
  * @param buffer The buffer to load
@@ -814,13 +1710,15 @@ void input_switchInteractive() {
 int input_loadBuffer(char *buffer) {
     input_unloadBuffer();
 
-    char buf[512];
-    snprintf(buf, 512, "%s\n", buffer);
+    size_t length = strlen(buffer);
 
     // Setup buffer parameters
-    input_buffer = strdup(buf);
-    input_buffer_len = strlen(buf);
-    input_buffer_size = 512;
+    input_buffer = malloc(length + 2);
+    memcpy(input_buffer, buffer, length);
+    input_buffer[length++] = '\n';
+    input_buffer[length] = 0;
+    input_buffer_len = length;
+    input_buffer_size = length + 1;
     input_buffer_idx = 0;
     essence_unread_character = 0;
     return 0;
@@ -830,15 +1728,15 @@ int input_loadBuffer(char *buffer) {
  * @brief Unload buffer
  */
 void input_unloadBuffer() {
-    if (input_buffer) {
+    if (input_buffer && !input_buffer_borrowed) {
         free(input_buffer);
     }
 
+    input_buffer_borrowed = 0;
+
     input_buffer = NULL;
     input_buffer_idx = 0;
     input_buffer_size = 0;
     input_buffer_len = 0;
-    essence_prompt_x = 0;
-    saved_input_buffer = NULL;
     history_index = 0;
 }
\ No newline at end of file
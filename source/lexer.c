@@ -34,6 +34,7 @@ token_t *lexer_getToken(token_t *prev) {
 
     token_t *t = malloc(sizeof(token_t));
     t->type = token_characterToType(ch);
+    t->column = input_getColumn();
 
     // Are we a string token?
     if (t->type == TOKEN_TYPE_STRING) {
@@ -97,6 +98,18 @@ token_t *lexer_getToken(token_t *prev) {
         lexer_ungetToken(next);
     }
 
+    if (t->type == TOKEN_TYPE_REDIRECT_OUT && (!prev || prev->type != TOKEN_TYPE_REDIRECT_OUT)) {
+        token_t *next = lexer_getToken(t);
+
+        if (next && next->type == TOKEN_TYPE_REDIRECT_OUT) {
+            free(t);
+            next->type = TOKEN_TYPE_REDIRECT_APPEND;
+            return next;
+        }
+
+        lexer_ungetToken(next);
+    }
+
     return t;
 }
 
@@ -18,6 +18,9 @@
 #include <getopt.h>
 #include <stdio.h>
 #include <signal.h>
+#include <time.h>
+
+extern char **environ;
 
 /* Shell argc + argv */
 int essence_argc = 1;
@@ -26,12 +29,22 @@ char **essence_argv = NULL;
 /* PID */
 int essence_pid = -1;
 
+/* Shell options (see shopt) */
+int essence_options = 0;
+
 void usage() {
     printf("essence, version %d.%d.%d\n", ESSENCE_VERSION_MAJOR, ESSENCE_VERSION_MINOR, ESSENCE_VERSION_LOWER);
     printf("Usage:  essence [OPTION] ...\n");
     printf("        essence [OPTION] script-file ...\n\n");
 
-    printf(" -c COMMAND     Execute command\n");
+    printf(" -c COMMAND     Execute command (remaining arguments are $0, $1, ...)\n");
+    printf(" -s             Read commands from standard input\n");
+    printf(" -n [--stats] [FILE ...]\n");
+    printf("                Check the syntax of scripts (or standard input) without running them\n");
+    printf(" --bench-prompt[=COUNT]\n");
+    printf("                Time rendering $PS1 COUNT times (default 100000)\n");
+    printf(" --compile FILE [-o OUTPUT]\n");
+    printf("                Compile a script to bytecode (default OUTPUT is FILE with a 'c' appended)\n");
     printf(" -h, --help     Show this help screen\n");
     printf(" -v, --version  Print out the version and exit\n");
     exit(1);
@@ -54,7 +67,17 @@ int essence_runScript(char *filename) {
         return 127;
     } 
 
-    while (!feof(input_script)) {
+    // Precompiled scripts run straight from the mapping
+    if (vm_isProgram(input_script->data, input_script->length)) {
+        vm_program_t program;
+        if (!vm_load(filename, input_script->data, input_script->length, &program)) vm_run(&program);
+        else cmd_last_exit_status = 126;
+
+        input_switchInteractive();
+        return cmd_last_exit_status;
+    }
+
+    while (1) {
         char *input = input_get(NULL);
         if (!input || (*input == EOF)) break;
         parser_interpret();
@@ -67,6 +90,104 @@ int essence_runScript(char *filename) {
     return cmd_last_exit_status;
 }
 
+/**
+ * @brief Run a -c command string (lexed in place, no copy)
+ * @param string The commands
+ * @returns @c cmd_last_exit_status
+ */
+int essence_runString(char *string) {
+    input_loadString("-c", string);
+
+    while (1) {
+        char *input = input_get(NULL);
+        if (!input || (*input == EOF)) break;
+        parser_interpret();
+    }
+
+    return cmd_last_exit_status;
+}
+
+/**
+ * @brief Run commands from standard input when it isn't a terminal (or with -s)
+ * @returns @c cmd_last_exit_status
+ */
+int essence_runStream() {
+    input_loadStream(STDIN_FILENO);
+
+    while (1) {
+        char *input = input_get(NULL);
+        if (!input || (*input == EOF)) break;
+        parser_interpret();
+    }
+
+    return cmd_last_exit_status;
+}
+
+
+/**
+ * @brief Check the syntax of scripts without running them (-n)
+ *
+ * The scripts are compiled the way running them would, so whatever runs passes.
+ *
+ * @param count Number of scripts, standard input is checked if there are none
+ * @param files The scripts
+ * @param stats Print parse throughput
+ * @returns 0 if all are fine, 1 if one can't be read, 2 on syntax errors
+ */
+int essence_checkSyntax(int count, char **files, int stats) {
+    compile_stats_t totals = { 0 };
+    int status = 0;
+
+    parser_check_only = 1;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    if (!count) status = compile_check("/dev/stdin", &totals);
+
+    for (int i = 0; i < count; i++) {
+        int s = compile_check(files[i], &totals);
+        if (s > status) status = s;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (stats) {
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        if (seconds <= 0) seconds = 1e-9;
+
+        printf("%zu files, %zu lines, %zu bytes, %zu errors in %.3f ms\n", totals.files, totals.lines, totals.bytes, totals.errors, seconds * 1000);
+        printf("%.0f lines/s, %.1f MB/s\n", totals.lines / seconds, totals.bytes / seconds / (1024 * 1024));
+    }
+
+    return status;
+}
+
+/**
+ * @brief Time rendering the prompt (--bench-prompt)
+ * @param count Number of renders
+ * @returns 0
+ */
+int essence_benchPrompt(long count) {
+    struct timespec start, compiled, end;
+    size_t bytes = 0;
+
+    // The first render compiles PS1
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    input_getPrompt();
+    clock_gettime(CLOCK_MONOTONIC, &compiled);
+
+    for (long i = 0; i < count; i++) bytes += strlen(input_getPrompt());
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double first = (compiled.tv_sec - start.tv_sec) * 1e9 + (compiled.tv_nsec - start.tv_nsec);
+    double total = (end.tv_sec - compiled.tv_sec) * 1e9 + (end.tv_nsec - compiled.tv_nsec);
+
+    printf("first render (compile): %.0f ns\n", first);
+    printf("%ld renders, %zu bytes in %.3f ms, %.0f ns/render\n", count, bytes, total / 1e6, count ? total / count : 0);
+    return 0;
+}
 
 /**
  * @brief Setup shell
@@ -75,6 +196,13 @@ void essence_setup() {
 // extern void command_setSignals(int i);
     // command_setSignals(0);
     essence_pid = getpid();
+
+    // Import the environment into the variable store
+    variable_init(environ);
+
+    // Statistics, read-only and computed when they are read
+    variable_dynamic("EDITSTATS", input_editStats);
+    variable_dynamic("COMPLETESTATS", complete_getStats);
     
     // if (setpgid(essence_pid, essence_pid) < 0) {
     //     perror("setpgid");
@@ -94,20 +222,53 @@ int main(int argc, char *argv[]) {
     struct option options[] = {
         { .name = "help", .has_arg = no_argument, .flag = NULL, .val = 'h' },
         { .name = "version", .has_arg = no_argument, .flag = NULL, .val = 'v' },
+        { .name = "compile", .has_arg = required_argument, .flag = NULL, .val = 'C' },
+        { .name = "stats", .has_arg = no_argument, .flag = NULL, .val = 'S' },
+        { .name = "bench-prompt", .has_arg = optional_argument, .flag = NULL, .val = 'B' },
         { 0,0,0,0 }
     };
 
     // Read arguments
     int ch;
     int index;
+    int read_stdin = 0;
+    int check_only = 0;
+    int show_stats = 0;
+    long bench_prompt = -1;
+    char *command_string = NULL;
+    char *compile_source = NULL;
+    char *compile_output = NULL;
     opterr = 1;
-    while ((ch = getopt_long(argc, argv, "c:hv", (const struct option*)&options, &index)) != -1) {
+    while ((ch = getopt_long(argc, argv, "+c:hnsvo:", (const struct option*)&options, &index)) != -1) {
         if (ch == 0) ch = options[index].val;
         switch (ch) {
             case 'c':
-                input_loadBuffer(optarg);
-                parser_interpret(); 
-                return cmd_last_exit_status;
+                command_string = optarg;
+                break;
+
+            case 's':
+                read_stdin = 1;
+                break;
+
+            case 'n':
+                check_only = 1;
+                break;
+
+            case 'S':
+                show_stats = 1;
+                break;
+
+            case 'B':
+                bench_prompt = optarg ? strtol(optarg, NULL, 10) : 100000;
+                break;
+
+            case 'C':
+                compile_source = optarg;
+                break;
+
+            case 'o':
+                compile_output = optarg;
+                break;
 
             case 'v':
                 version();
@@ -121,6 +282,46 @@ int main(int argc, char *argv[]) {
     }
 
 
+    if (check_only) {
+        return essence_checkSyntax(argc - optind, &argv[optind], show_stats);
+    }
+
+    if (bench_prompt >= 0) {
+        return essence_benchPrompt(bench_prompt);
+    }
+
+    if (compile_source) {
+        // Default to the script name with a 'c' appended (script.es -> script.esc)
+        if (!compile_output) {
+            compile_output = malloc(strlen(compile_source) + 2);
+            sprintf(compile_output, "%sc", compile_source);
+        }
+
+        return compile_file(compile_source, compile_output);
+    }
+
+    if (command_string) {
+        // essence -c COMMAND [NAME [ARGUMENT ...]]
+        if (argc > optind) {
+            essence_argc = argc - optind;
+            essence_argv = &argv[optind];
+        } else {
+            essence_argc = 1;
+            essence_argv = argv;
+        }
+
+        return essence_runString(command_string);
+    }
+
+    if (read_stdin || (argc == optind && !isatty(STDIN_FILENO))) {
+        // $0 is the shell, the remaining arguments are the positionals
+        essence_argc = argc - optind + 1;
+        essence_argv = malloc((essence_argc + 1) * sizeof(char*));
+        essence_argv[0] = argv[0];
+        memcpy(&essence_argv[1], &argv[optind], (argc - optind + 1) * sizeof(char*));
+        return essence_runStream();
+    }
+
     essence_argc = argc-optind;
     essence_argv = &argv[optind];
 
@@ -129,7 +330,7 @@ int main(int argc, char *argv[]) {
     }
 
     char buffer[256];
-    snprintf(buffer, 256, "%s/.esrc", getenv("HOME"));
+    snprintf(buffer, 256, "%s/.esrc", variable_get("HOME"));
     essence_runScript(buffer);
 
     // Initialize input
@@ -0,0 +1,287 @@
+/**
+ * @file pattern.c
+ * @brief Compiled shell patterns
+ *
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "pattern.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* Class bitmap helpers */
+#define SET_ADD(set, ch)        ((set)[(unsigned char)(ch) >> 3] |= (1 << ((unsigned char)(ch) & 7)))
+#define SET_HAS(set, ch)        ((set)[(unsigned char)(ch) >> 3] & (1 << ((unsigned char)(ch) & 7)))
+
+/**
+ * @brief Check whether a character escapes the next one
+ */
+static inline int pattern_isEscape(char ch) {
+    return (ch == PATTERN_CTLESC || ch == '\\');
+}
+
+/**
+ * @brief Check whether a string contains unescaped wildcards
+ * @param str The string to check
+ * @param length Length of the string
+ */
+int pattern_hasMagic(const char *str, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (pattern_isEscape(str[i])) { i++; continue; }
+        if (str[i] == '*' || str[i] == '?' || str[i] == '[') return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Add a named character class ([:alpha:] etc.) to a set
+ * @returns Length consumed, or 0 if this is not a named class
+ */
+static size_t pattern_namedClass(const char *str, size_t length, unsigned char *set) {
+    static const struct { const char *name; int (*fn)(int); } classes[] = {
+        { "alnum", isalnum }, { "alpha", isalpha }, { "blank", isblank },
+        { "cntrl", iscntrl }, { "digit", isdigit }, { "graph", isgraph },
+        { "lower", islower }, { "print", isprint }, { "punct", ispunct },
+        { "space", isspace }, { "upper", isupper }, { "xdigit", isxdigit },
+    };
+
+    if (length < 2 || str[0] != '[' || str[1] != ':') return 0;
+
+    const char *end = NULL;
+    for (size_t i = 2; i + 1 < length; i++) {
+        if (str[i] == ':' && str[i+1] == ']') { end = &str[i]; break; }
+    }
+    if (!end) return 0;
+
+    size_t namelen = end - (str + 2);
+    for (size_t i = 0; i < sizeof(classes) / sizeof(*classes); i++) {
+        if (strlen(classes[i].name) == namelen && !strncmp(classes[i].name, str + 2, namelen)) {
+            for (int ch = 1; ch < 256; ch++) if (classes[i].fn(ch)) SET_ADD(set, ch);
+            return namelen + 4;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Compile a bracket expression
+ * @param str Pointer to the character after the opening '['
+ * @param length Remaining length
+ * @param node The node to fill
+ * @returns Characters consumed (including the closing ']'), or 0 if it is not terminated
+ */
+static size_t pattern_compileClass(const char *str, size_t length, pattern_node_t *node) {
+    size_t i = 0;
+    int negate = 0;
+
+    memset(node->set, 0, sizeof(node->set));
+
+    if (i < length && (str[i] == '!' || str[i] == '^')) { negate = 1; i++; }
+
+    int first = 1;
+    while (i < length) {
+        if (str[i] == ']' && !first) break;
+        first = 0;
+
+        size_t named = pattern_namedClass(str + i, length - i, node->set);
+        if (named) { i += named; continue; }
+
+        unsigned char lo = str[i];
+        if (pattern_isEscape(lo) && i + 1 < length) lo = str[++i];
+        i++;
+
+        // Range?
+        if (i + 1 < length && str[i] == '-' && str[i+1] != ']') {
+            i++;
+            unsigned char hi = str[i];
+            if (pattern_isEscape(hi) && i + 1 < length) hi = str[++i];
+            i++;
+
+            for (int ch = lo; ch <= hi; ch++) SET_ADD(node->set, ch);
+            continue;
+        }
+
+        SET_ADD(node->set, lo);
+    }
+
+    if (i >= length) return 0;
+
+    if (negate) {
+        for (int b = 0; b < 32; b++) node->set[b] = ~node->set[b];
+        node->set[0] &= ~1; // Never match NUL
+    }
+
+    node->type = PATTERN_NODE_CLASS;
+    return i + 1;
+}
+
+/**
+ * @brief Compile a pattern
+ * @param str The pattern string (may contain @c PATTERN_CTLESC and backslash escapes)
+ * @param length Length of the pattern
+ * @returns A compiled pattern, free with @c pattern_destroy
+ */
+pattern_t *pattern_compile(const char *str, size_t length) {
+    pattern_t *pat = malloc(sizeof(pattern_t));
+    pat->nodes = malloc(sizeof(pattern_node_t) * (length + 1));
+    pat->node_count = 0;
+    pat->pool = malloc(length + 1);
+    pat->flags = 0;
+
+    size_t poolidx = 0;
+    pattern_node_t *lit = NULL;
+
+    for (size_t i = 0; i < length; ) {
+        char ch = str[i];
+
+        if (ch == '*') {
+            // Collapse runs of stars
+            if (!pat->node_count || pat->nodes[pat->node_count-1].type != PATTERN_NODE_STAR) {
+                pat->nodes[pat->node_count++].type = PATTERN_NODE_STAR;
+            }
+
+            pat->flags |= PATTERN_FLAG_MAGIC;
+            lit = NULL;
+            i++;
+            continue;
+        }
+
+        if (ch == '?') {
+            pat->nodes[pat->node_count++].type = PATTERN_NODE_ANY;
+            pat->flags |= PATTERN_FLAG_MAGIC;
+            lit = NULL;
+            i++;
+            continue;
+        }
+
+        if (ch == '[') {
+            size_t used = pattern_compileClass(str + i + 1, length - i - 1, &pat->nodes[pat->node_count]);
+            if (used) {
+                pat->node_count++;
+                pat->flags |= PATTERN_FLAG_MAGIC;
+                lit = NULL;
+                i += used + 1;
+                continue;
+            }
+
+            // Unterminated, treat as a literal '['
+        }
+
+        if (pattern_isEscape(ch) && i + 1 < length) {
+            ch = str[++i];
+        }
+
+        if (!lit) {
+            lit = &pat->nodes[pat->node_count++];
+            lit->type = PATTERN_NODE_LITERAL;
+            lit->literal = &pat->pool[poolidx];
+            lit->length = 0;
+        }
+
+        pat->pool[poolidx++] = ch;
+        lit->length++;
+        i++;
+    }
+
+    pat->pool[poolidx] = 0;
+
+    if (pat->node_count && pat->nodes[0].type == PATTERN_NODE_LITERAL && pat->nodes[0].literal[0] == '.') {
+        pat->flags |= PATTERN_FLAG_DOT;
+    }
+
+    return pat;
+}
+
+/**
+ * @brief Match a single fixed-width node at a position
+ */
+static inline int pattern_matchNode(pattern_node_t *node, const char *str, size_t length, size_t *si) {
+    switch (node->type) {
+        case PATTERN_NODE_LITERAL:
+            if (length - *si < node->length || memcmp(str + *si, node->literal, node->length)) return 0;
+            *si += node->length;
+            return 1;
+
+        case PATTERN_NODE_ANY:
+            if (*si >= length) return 0;
+            (*si)++;
+            return 1;
+
+        case PATTERN_NODE_CLASS:
+            if (*si >= length || !SET_HAS(node->set, str[*si])) return 0;
+            (*si)++;
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Match a string against a compiled pattern
+ * @param pat The compiled pattern
+ * @param str The string to match
+ * @param length Length of the string
+ * @returns 1 on match
+ */
+int pattern_match(pattern_t *pat, const char *str, size_t length) {
+    size_t ni = 0, si = 0;
+    size_t star_ni = (size_t)-1, star_si = 0;
+
+    // Every node except a star has a fixed width, so backtracking only ever
+    // needs to resume from the most recent star.
+    while (ni < pat->node_count || si < length) {
+        if (ni < pat->node_count) {
+            pattern_node_t *node = &pat->nodes[ni];
+
+            if (node->type == PATTERN_NODE_STAR) {
+                star_ni = ni++;
+                star_si = si;
+
+                // A trailing star swallows the rest of the string
+                if (ni == pat->node_count) return 1;
+                continue;
+            }
+
+            if (pattern_matchNode(node, str, length, &si)) {
+                ni++;
+                continue;
+            }
+        }
+
+        // Mismatch, let the last star absorb one more character
+        if (star_ni == (size_t)-1 || star_si >= length) return 0;
+        star_si++;
+
+        // If the star is followed by a literal, skip straight to its next occurrence
+        pattern_node_t *after = (star_ni + 1 < pat->node_count) ? &pat->nodes[star_ni + 1] : NULL;
+        if (after && after->type == PATTERN_NODE_LITERAL) {
+            const char *next = memchr(str + star_si, after->literal[0], length - star_si);
+            if (!next) return 0;
+            star_si = next - str;
+        }
+
+        ni = star_ni + 1;
+        si = star_si;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Destroy a compiled pattern
+ * @param pat The pattern to destroy
+ */
+void pattern_destroy(pattern_t *pat) {
+    free(pat->nodes);
+    free(pat->pool);
+    free(pat);
+}
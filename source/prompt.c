@@ -0,0 +1,483 @@
+/**
+ * @file prompt.c
+ * @brief Compiled PS1/PS2 prompts
+ *
+ * A prompt string is compiled into a list of ops when it changes. What can't
+ * change while the shell runs (user, host, shell name, version) is resolved
+ * then and becomes literal text, so rendering a prompt only copies text and
+ * fills in the time, the working directory and the exit status colour.
+ *
+ * Segments (\{NAME}) show the output of a command that runs in the
+ * background. The prompt never waits for them: it shows the last output the
+ * command gave in the same directory, and the line editor draws the prompt
+ * again when new output arrives.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pwd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+/* Looked up once, the user lookup can go over the network */
+static char *prompt_user = NULL;
+static char *prompt_host = NULL;
+
+/* Working directory, kept up to date by cd */
+static char *prompt_cwd = NULL;
+
+/* Segment results, one per name and directory */
+static prompt_segment_t *prompt_segments = NULL;
+
+/* Counts prompts, segments are started again once per prompt */
+static unsigned long prompt_epoch = 1;
+
+/**
+ * @brief Get the name of the user
+ */
+static const char *prompt_getUser() {
+    if (!prompt_user) {
+        struct passwd *pw = getpwuid(geteuid());
+        prompt_user = strdup(pw ? pw->pw_name : "This-user-does-not-exist");
+    }
+
+    return prompt_user;
+}
+
+/**
+ * @brief Get the hostname
+ */
+static const char *prompt_getHost() {
+    if (!prompt_host) {
+        char host[256] = { 0 };
+        gethostname(host, sizeof(host) - 1);
+        prompt_host = strdup(host);
+    }
+
+    return prompt_host;
+}
+
+/**
+ * @brief Read the working directory again, after it changed
+ */
+void prompt_setCwd() {
+    free(prompt_cwd);
+    prompt_cwd = getcwd(NULL, 0);
+    if (!prompt_cwd) prompt_cwd = strdup(".");
+}
+
+/**
+ * @brief Add literal text to a prompt, joining it to the text before if possible
+ */
+static void prompt_addText(prompt_t *p, const char *text, size_t length) {
+    prompt_op_t *last = p->op_count ? &p->ops[p->op_count - 1] : NULL;
+
+    if (!last || last->type != PROMPT_OP_TEXT) {
+        prompt_op_t op = { .type = PROMPT_OP_TEXT, .offset = p->text->bufidx, .length = 0 };
+        if (p->op_count == p->op_size) {
+            p->op_size *= 2;
+            p->ops = realloc(p->ops, p->op_size * sizeof(prompt_op_t));
+        }
+
+        p->ops[p->op_count++] = op;
+        last = &p->ops[p->op_count - 1];
+    }
+
+    buffer_append(p->text, text, length);
+    last->length += length;
+}
+
+/**
+ * @brief Add an op that is filled in when the prompt is rendered
+ */
+static void prompt_addOp(prompt_t *p, int type) {
+    if (p->op_count == p->op_size) {
+        p->op_size *= 2;
+        p->ops = realloc(p->ops, p->op_size * sizeof(prompt_op_t));
+    }
+
+    p->ops[p->op_count++] = (prompt_op_t){ .type = type, .offset = 0, .length = 0 };
+    if (type >= PROMPT_OP_DATE && type <= PROMPT_OP_TIME_AMPM) p->time = 1;
+}
+
+/**
+ * @brief Compile a PS string
+ *
+ * I used https://ss64.com/bash/syntax-prompt.html as my reference for PS-syntax.
+ */
+static void prompt_compile(prompt_t *p, const char *source) {
+    if (!p->ops) {
+        p->op_size = PROMPT_INITIAL_OPS;
+        p->ops = malloc(p->op_size * sizeof(prompt_op_t));
+        p->text = buffer_create(strlen(source) + 1);
+        p->out = buffer_create(strlen(source) + 1);
+    }
+
+    free(p->source);
+    p->source = strdup(source);
+    p->text->bufidx = 0;
+    p->op_count = 0;
+    p->time = 0;
+
+    char tmp[128];
+
+    for (const char *s = source; *s; s++) {
+        if (*s != '\\') {
+            // Up to the next escape in one go
+            size_t length = strcspn(s, "\\");
+            prompt_addText(p, s, length);
+            s += length - 1;
+            continue;
+        }
+
+        s++;
+        if (!*s) {
+            prompt_addText(p, "\\", 1);
+            break;
+        }
+
+        const char *text = NULL;
+        switch (*s) {
+            case 'd': prompt_addOp(p, PROMPT_OP_DATE); break;
+            case 't': prompt_addOp(p, PROMPT_OP_TIME_24); break;
+            case 'T': prompt_addOp(p, PROMPT_OP_TIME_12); break;
+            case '@': prompt_addOp(p, PROMPT_OP_TIME_AMPM); break;
+            case 'w': prompt_addOp(p, PROMPT_OP_CWD); break;
+            case 'W': prompt_addOp(p, PROMPT_OP_CWD_BASE); break;
+            case '+': prompt_addOp(p, PROMPT_OP_STATUS); break;
+
+            case '{': ;
+                // \{NAME}, the name is kept in the text but isn't part of a text op
+                const char *end = strchr(s, '}');
+                if (!end) end = s + strlen(s);
+
+                prompt_addOp(p, PROMPT_OP_SEGMENT);
+                p->ops[p->op_count - 1].offset = p->text->bufidx;
+                p->ops[p->op_count - 1].length = end - s - 1;
+                buffer_append(p->text, s + 1, end - s - 1);
+
+                s = *end ? end : end - 1;
+                break;
+
+            case 'h':
+                // Hostname up to the first .
+                text = prompt_getHost();
+                prompt_addText(p, text, strcspn(text, "."));
+                text = NULL;
+                break;
+
+            case 'H': text = prompt_getHost(); break;
+            case 'u': text = prompt_getUser(); break;
+            case 'j': text = "0"; break;            // Currently running jobs
+            case 's': text = "essence"; break;      // Name of the shell
+            case '$': text = geteuid() ? "$" : "#"; break;
+            case 'e': text = "\033"; break;
+            case 'n': text = "\n"; break;
+
+            // Text that takes no room on the screen, e.g. colours
+            case '[': tmp[0] = INPUT_PROMPT_HIDE_START; tmp[1] = 0; text = tmp; break;
+            case ']': tmp[0] = INPUT_PROMPT_HIDE_END; tmp[1] = 0; text = tmp; break;
+
+            case 'v':
+            case 'V':
+                snprintf(tmp, sizeof(tmp), "%d.%d.%d", ESSENCE_VERSION_MAJOR, ESSENCE_VERSION_MINOR, ESSENCE_VERSION_LOWER);
+                text = tmp;
+                break;
+        }
+
+        if (text) prompt_addText(p, text, strlen(text));
+    }
+}
+
+/**
+ * @brief Get a setting of a segment, e.g. PROMPT_SEGMENTS[NAME]
+ */
+static const char *prompt_segmentSetting(const char *array, const char *name) {
+    variable_t *v = variable_find(array);
+    if (!v || !v->array) return NULL;
+    return variable_getElement(v, name);
+}
+
+/**
+ * @brief Get the current time in milliseconds
+ */
+static long long prompt_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Find the result of a segment in the working directory, creating it if needed
+ */
+static prompt_segment_t *prompt_findSegment(const char *name, size_t length) {
+    for (prompt_segment_t *seg = prompt_segments; seg; seg = seg->next) {
+        if (!strncmp(seg->name, name, length) && !seg->name[length] && !strcmp(seg->cwd, prompt_cwd)) return seg;
+    }
+
+    prompt_segment_t *seg = calloc(1, sizeof(prompt_segment_t));
+    seg->name = strndup(name, length);
+    seg->cwd = strdup(prompt_cwd);
+    seg->fd = -1;
+    seg->output = buffer_create(PROMPT_SEGMENT_MAX);
+    seg->next = prompt_segments;
+    prompt_segments = seg;
+    return seg;
+}
+
+/**
+ * @brief Start the command of a segment in the background
+ *
+ * The command is PROMPT_SEGMENTS[NAME], or NAME itself if that isn't set. It
+ * is killed after PROMPT_TIMEOUTS[NAME] milliseconds (default 2000).
+ */
+static void prompt_startSegment(prompt_segment_t *seg) {
+    const char *command = prompt_segmentSetting("PROMPT_SEGMENTS", seg->name);
+    if (!command) command = seg->name;
+
+    const char *timeout = prompt_segmentSetting("PROMPT_TIMEOUTS", seg->name);
+    long long ms = timeout ? atoll(timeout) : PROMPT_SEGMENT_TIMEOUT;
+
+    seg->epoch = prompt_epoch;
+
+    int pfd[2];
+    if (pipe(pfd) < 0) return;
+
+    // Anything not written out yet would be written by the copy as well
+    fflush(stdout);
+
+    pid_t cpid = fork();
+    if (cpid < 0) {
+        close(pfd[0]);
+        close(pfd[1]);
+        return;
+    }
+
+    if (!cpid) {
+        // Its own process group, and the commands it runs stay in it, so a timeout kills them too
+        setpgid(0, 0);
+        cmd_job_control = 0;
+
+        int null = open("/dev/null", O_RDWR);
+        dup2(null, STDIN_FILENO);
+        dup2(null, STDERR_FILENO);
+        dup2(pfd[1], STDOUT_FILENO);
+        close(pfd[0]);
+        close(pfd[1]);
+        close(null);
+
+        parser_reset();
+        input_loadBuffer((char*)command);
+        parser_interpret();
+
+        fflush(stdout);
+        _exit(cmd_last_exit_status);
+    }
+
+    setpgid(cpid, cpid);
+    close(pfd[1]);
+    fcntl(pfd[0], F_SETFL, O_NONBLOCK);
+    fcntl(pfd[0], F_SETFD, FD_CLOEXEC);
+
+    seg->pid = cpid;
+    seg->fd = pfd[0];
+    seg->output->bufidx = 0;
+    seg->deadline = prompt_now() + ms;
+}
+
+/**
+ * @brief Start a new prompt, segments shown in it are run again
+ */
+void prompt_next() {
+    prompt_epoch++;
+}
+
+/**
+ * @brief Get what the running segment commands should be waited on with
+ * @param fds Output file descriptors to poll for input
+ * @param max Room in @c fds
+ * @param timeout Output milliseconds until a command times out, -1 if none is running
+ * @returns Number of file descriptors
+ */
+size_t prompt_pollFds(struct pollfd *fds, size_t max, int *timeout) {
+    long long now = prompt_now();
+    size_t count = 0;
+    *timeout = -1;
+
+    for (prompt_segment_t *seg = prompt_segments; seg; seg = seg->next) {
+        if (!seg->pid) continue;
+
+        long long left = seg->deadline - now;
+        if (left < 0) left = 0;
+
+        // Output closed but not exited yet, look again soon
+        if (seg->fd < 0 && left > 50) left = 50;
+        if (*timeout < 0 || left < *timeout) *timeout = left;
+
+        if (seg->fd >= 0 && count < max) {
+            fds[count].fd = seg->fd;
+            fds[count].events = POLLIN;
+            fds[count].revents = 0;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Take the output of a segment command as its value
+ * @returns 1 if the value changed
+ */
+static int prompt_finishSegment(prompt_segment_t *seg) {
+    close(seg->fd);
+    seg->fd = -1;
+
+    // Only the first line is shown
+    char *value = seg->output->buffer;
+    value[strcspn(value, "\n")] = 0;
+    if (seg->value && !strcmp(seg->value, value)) return 0;
+
+    free(seg->value);
+    seg->value = strdup(value);
+    return 1;
+}
+
+/**
+ * @brief Collect output from segment commands without waiting, killing those that ran too long
+ * @returns 1 if a segment shows something new
+ */
+int prompt_update() {
+    long long now = prompt_now();
+    int changed = 0;
+
+    for (prompt_segment_t *seg = prompt_segments; seg; seg = seg->next) {
+        if (!seg->pid) continue;
+
+        int exited = (waitpid(seg->pid, NULL, WNOHANG) == seg->pid);
+
+        while (seg->fd >= 0) {
+            char chunk[512];
+            ssize_t r = read(seg->fd, chunk, sizeof(chunk));
+            if (r < 0 && errno == EINTR) continue;
+            if (r < 0) break;
+
+            if (!r) {
+                changed |= prompt_finishSegment(seg);
+                break;
+            }
+
+            // Anything past the limit is read and dropped
+            size_t room = PROMPT_SEGMENT_MAX - 1 - seg->output->bufidx;
+            buffer_append(seg->output, chunk, (size_t)r < room ? (size_t)r : room);
+        }
+
+        if (exited) {
+            // Something it left running in the background may still hold the output open
+            if (seg->fd >= 0) changed |= prompt_finishSegment(seg);
+            seg->pid = 0;
+        } else if (now >= seg->deadline) {
+            // Too slow, the last known value stays
+            kill(-seg->pid, SIGKILL);
+            while (waitpid(seg->pid, NULL, 0) < 0 && errno == EINTR);
+            seg->pid = 0;
+
+            if (seg->fd >= 0) {
+                close(seg->fd);
+                seg->fd = -1;
+            }
+        }
+    }
+
+    return changed;
+}
+
+/**
+ * @brief Render a prompt, compiling it again first if its PS string changed
+ * @param p The prompt
+ * @param source The PS string
+ * @returns The prompt, valid until it is rendered again
+ */
+const char *prompt_render(prompt_t *p, const char *source) {
+    if (!p->source || strcmp(p->source, source)) prompt_compile(p, source);
+
+    struct tm tm;
+    if (p->time) {
+        time_t t = time(NULL);
+        localtime_r(&t, &tm);
+    }
+
+    char tmp[128];
+    buffer_t *out = p->out;
+    out->bufidx = 0;
+
+    for (size_t i = 0; i < p->op_count; i++) {
+        prompt_op_t *op = &p->ops[i];
+        size_t length;
+
+        switch (op->type) {
+            case PROMPT_OP_TEXT:
+                buffer_append(out, p->text->buffer + op->offset, op->length);
+                break;
+
+            case PROMPT_OP_DATE:
+            case PROMPT_OP_TIME_24:
+            case PROMPT_OP_TIME_12:
+            case PROMPT_OP_TIME_AMPM: ;
+                static const char *formats[] = { "%a %B %d", "%H:%M:%S", "%I:%M:%S", "%I:%M %p" };
+                length = strftime(tmp, sizeof(tmp), formats[op->type - PROMPT_OP_DATE], &tm);
+                buffer_append(out, tmp, length);
+                break;
+
+            case PROMPT_OP_CWD:
+            case PROMPT_OP_CWD_BASE: ;
+                if (!prompt_cwd) prompt_setCwd();
+                const char *cwd = prompt_cwd;
+
+                if (op->type == PROMPT_OP_CWD_BASE) {
+                    const char *slash = strrchr(cwd, '/');
+                    if (slash && slash[1]) cwd = slash + 1;
+                    buffer_append(out, cwd, strlen(cwd));
+                    break;
+                }
+
+                // The home directory is shown as ~
+                const char *home = variable_get("HOME");
+                size_t home_length = home ? strlen(home) : 0;
+                if (home_length > 1 && !strncmp(cwd, home, home_length) && (!cwd[home_length] || cwd[home_length] == '/')) {
+                    buffer_append(out, "~", 1);
+                    cwd += home_length;
+                }
+
+                buffer_append(out, cwd, strlen(cwd));
+                break;
+
+            case PROMPT_OP_STATUS:
+                buffer_append(out, cmd_last_exit_status ? "\033[31m" : "\033[32m", 5);
+                break;
+
+            case PROMPT_OP_SEGMENT: ;
+                if (!prompt_cwd) prompt_setCwd();
+                prompt_segment_t *seg = prompt_findSegment(p->text->buffer + op->offset, op->length);
+
+                if (seg->epoch != prompt_epoch && !seg->pid) prompt_startSegment(seg);
+                if (seg->value) buffer_append(out, seg->value, strlen(seg->value));
+                break;
+        }
+    }
+
+    return out->buffer;
+}
@@ -82,6 +82,16 @@ char *token_typeToString(int type) {
         case TOKEN_TYPE_OPEN_PAREN:
         case TOKEN_TYPE_CLOSE_PAREN:    
             return "<paren>";
+        case TOKEN_TYPE_PIPE:
+            return "<pipe>";
+        case TOKEN_TYPE_SEMICOLON:
+            return "<semicolon>";
+        case TOKEN_TYPE_AMPERSAND:
+            return "<ampersand>";
+        case TOKEN_TYPE_REDIRECT_OUT:
+        case TOKEN_TYPE_REDIRECT_IN:
+        case TOKEN_TYPE_REDIRECT_APPEND:
+            return "<redirect>";
         default:
             return "<unknown>";
     }
@@ -0,0 +1,900 @@
+/**
+ * @file variable.c
+ * @brief Shell variable store
+ *
+ * Variables live in an open-addressing hash table separate from environ.
+ * Each name is allocated exactly once in its variable_t, and variables are
+ * never freed (unset only clears the value), so pointers to them stay valid.
+ * The environment for commands is only built from the exported subset when
+ * a command is spawned. Dynamic variables (shell statistics) are read-only
+ * and have their value computed again every time they are looked up.
+ *
+ * Indexed arrays are a vector indexed directly by subscript while most of
+ * it is used. Once the indices are too far apart for that (a[16000000]=x),
+ * the array goes sparse: just the set elements, sorted by index and found
+ * with a binary search. It goes back to a vector when it fills up. Associative
+ * arrays keep their elements in insertion order with an open-addressing
+ * index on top; unset elements stay behind as tombstones until the index is
+ * rebuilt.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <limits.h>
+
+/* Variable table */
+static variable_t **variable_table = NULL;
+static size_t variable_table_size = 0;
+static size_t variable_table_count = 0;
+
+/* Exported environment cache */
+static char **variable_environ_cache = NULL;
+static unsigned long variable_export_generation = 1;
+static unsigned long variable_environ_generation = 0;
+
+/**
+ * @brief Hash a variable name (FNV-1a)
+ */
+static unsigned int variable_hash(const char *name, size_t length) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/**
+ * @brief Find the slot for a name
+ * @returns Pointer to the slot, which is NULL if the name is not present
+ */
+static variable_t **variable_slot(const char *name, size_t length, unsigned int hash) {
+    size_t mask = variable_table_size - 1;
+    size_t i = hash & mask;
+
+    while (variable_table[i]) {
+        variable_t *v = variable_table[i];
+        if (v->hash == hash && !strncmp(v->name, name, length) && !v->name[length]) break;
+        i = (i + 1) & mask;
+    }
+
+    return &variable_table[i];
+}
+
+/**
+ * @brief Grow the variable table
+ */
+static void variable_grow() {
+    variable_t **old = variable_table;
+    size_t old_size = variable_table_size;
+
+    variable_table_size = old_size ? old_size * 2 : VARIABLE_INITIAL_TABLE_SIZE;
+    variable_table = calloc(variable_table_size, sizeof(variable_t*));
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (!old[i]) continue;
+
+        size_t j = old[i]->hash & (variable_table_size - 1);
+        while (variable_table[j]) j = (j + 1) & (variable_table_size - 1);
+        variable_table[j] = old[i];
+    }
+
+    free(old);
+}
+
+/**
+ * @brief Store a value, reusing the existing allocation where possible
+ */
+static void variable_store(variable_t *v, const char *value, size_t length) {
+    if (!v->value || v->value_size < length + 1) {
+        free(v->value);
+        v->value_size = (length + 1 < 16) ? 16 : length + 1;
+        v->value = malloc(v->value_size);
+    }
+
+    memcpy(v->value, value, length);
+    v->value[length] = 0;
+
+    if (v->flags & VARIABLE_FLAG_EXPORT) variable_export_generation++;
+}
+
+/**
+ * @brief Bring the value of a dynamic variable up to date
+ */
+static void variable_refresh(variable_t *v) {
+    if (!v || !v->getter || v->type != VARIABLE_TYPE_SCALAR) return;
+
+    char buffer[256];
+    v->getter(buffer, sizeof(buffer));
+    variable_store(v, buffer, strlen(buffer));
+}
+
+/**
+ * @brief Find a variable
+ * @param name The variable name
+ * @returns The variable, or NULL if it has never been declared
+ */
+variable_t *variable_find(const char *name) {
+    if (!variable_table) return NULL;
+
+    size_t length = strlen(name);
+    variable_t *v = *variable_slot(name, length, variable_hash(name, length));
+    variable_refresh(v);
+    return v;
+}
+
+/**
+ * @brief Find or create a variable
+ * @param name The variable name
+ */
+variable_t *variable_create(const char *name) {
+    if ((variable_table_count + 1) * 10 >= variable_table_size * 7) variable_grow();
+
+    size_t length = strlen(name);
+    unsigned int hash = variable_hash(name, length);
+    variable_t **slot = variable_slot(name, length, hash);
+    if (*slot) return *slot;
+
+    variable_t *v = malloc(sizeof(variable_t) + length + 1);
+    v->value = NULL;
+    v->value_size = 0;
+    v->flags = 0;
+    v->type = VARIABLE_TYPE_SCALAR;
+    v->array = NULL;
+    v->getter = NULL;
+    v->hash = hash;
+    memcpy(v->name, name, length + 1);
+
+    *slot = v;
+    variable_table_count++;
+    return v;
+}
+
+/**
+ * @brief Create a read-only variable whose value is computed whenever it is read
+ * @param name The variable name
+ * @param getter Writes the current value into a buffer
+ * @returns The variable
+ */
+variable_t *variable_dynamic(const char *name, variable_getter_t getter) {
+    variable_t *v = variable_create(name);
+    v->getter = getter;
+    v->flags |= VARIABLE_FLAG_READONLY;
+    variable_refresh(v);
+    return v;
+}
+
+/**
+ * @brief Get the value of a variable
+ * @param name The variable name
+ * @returns The value, or NULL if unset
+ */
+const char *variable_get(const char *name) {
+    variable_t *v = variable_find(name);
+    if (!v) return NULL;
+    if (v->array) return variable_getElement(v, "0");
+    return v->value;
+}
+
+/**
+ * @brief Check that a variable may be assigned
+ */
+static int variable_writable(variable_t *v) {
+    if (v->flags & VARIABLE_FLAG_READONLY) {
+        fprintf(stderr, "essence: %s: readonly variable\n", v->name);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Work out the value to store, applying the integer attribute and +=
+ * @param v The variable
+ * @param old The current value (or NULL)
+ * @param value The value being assigned
+ * @param append Nonzero for +=
+ * @param result Set to an allocated value, or NULL if @c value can be stored as is
+ * @returns 0 on success
+ */
+static int variable_compute(variable_t *v, const char *old, const char *value, int append, char **result) {
+    *result = NULL;
+
+    if (v->flags & VARIABLE_FLAG_INTEGER) {
+        long long n;
+        if (arith_evaluate((char*)value, &n) < 0) return -1;
+        if (append && old) n += strtoll(old, NULL, 10);
+
+        *result = malloc(32);
+        snprintf(*result, 32, "%lld", n);
+        return 0;
+    }
+
+    if (append && old) {
+        size_t oldlen = strlen(old);
+        size_t len = strlen(value);
+        *result = malloc(oldlen + len + 1);
+        memcpy(*result, old, oldlen);
+        memcpy(*result + oldlen, value, len + 1);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Set a scalar value (element 0 of an array)
+ */
+static int variable_setValue(variable_t *v, const char *value, int append) {
+    if (!variable_writable(v)) return -1;
+    if (v->type == VARIABLE_TYPE_INDEXED) return variable_setIndex(v, 0, value, append);
+    if (v->type == VARIABLE_TYPE_ASSOC) return variable_setElement(v, "0", value, append);
+
+    char *computed;
+    if (variable_compute(v, v->value, value, append, &computed) < 0) return -1;
+
+    if (computed) {
+        variable_store(v, computed, strlen(computed));
+        free(computed);
+    } else {
+        variable_store(v, value, strlen(value));
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Set a variable, honouring its attributes
+ * @param name The variable name
+ * @param value The new value
+ * @returns 0 on success
+ */
+int variable_set(const char *name, const char *value) {
+    return variable_setValue(variable_create(name), value, 0);
+}
+
+/**
+ * @brief Perform an assignment statement
+ * @param statement NAME=VALUE, NAME+=VALUE, NAME[SUB]=VALUE or NAME=<VARIABLE_COMPOUND>LIST
+ * @returns 0 on success
+ */
+int variable_assign(const char *statement) {
+    const char *p = statement;
+    while (isalnum((unsigned char)*p) || *p == '_') p++;
+
+    char name[256];
+    size_t length = p - statement;
+    if (!length || length >= sizeof(name) || isdigit((unsigned char)*statement)) goto _invalid;
+    memcpy(name, statement, length);
+    name[length] = 0;
+
+    // Subscript
+    char *subscript = NULL;
+    if (*p == '[') {
+        const char *start = ++p;
+        int depth = 1;
+        while (*p && !(*p == ']' && !--depth)) { if (*p == '[') depth++; p++; }
+        if (!*p) goto _invalid;
+
+        subscript = strndup(start, p - start);
+        p++;
+    }
+
+    int append = (*p == '+');
+    if (append) p++;
+    if (*p != '=') { free(subscript); goto _invalid; }
+    p++;
+
+    variable_t *v = variable_create(name);
+    int ret;
+
+    if (*p == VARIABLE_COMPOUND) {
+        if (subscript) {
+            fprintf(stderr, "essence: %s: cannot assign list to array member\n", name);
+            free(subscript);
+            return -1;
+        }
+
+        if (!variable_writable(v)) return -1;
+
+        if (v->type == VARIABLE_TYPE_SCALAR || !append) {
+            int type = (v->type == VARIABLE_TYPE_ASSOC) ? VARIABLE_TYPE_ASSOC : VARIABLE_TYPE_INDEXED;
+            if (!variable_declareArray(name, type)) return -1;
+            if (!append) variable_clearArray(v);
+        }
+
+        char *list = strdup(p + 1);
+        ret = expand_compoundAssign(v, list);
+        free(list);
+        return ret;
+    }
+
+    if (subscript) {
+        ret = variable_writable(v) ? variable_setElement(v, subscript, p, append) : -1;
+        free(subscript);
+        return ret;
+    }
+
+    return variable_setValue(v, p, append);
+
+_invalid:
+    fprintf(stderr, "essence: %s: not a valid identifier\n", statement);
+    return -1;
+}
+
+/**
+ * @brief Change the attributes of a variable
+ * @param name The variable name
+ * @param set Flags to set
+ * @param clear Flags to clear
+ * @returns 0 on success
+ */
+int variable_setFlags(const char *name, int set, int clear) {
+    variable_t *v = variable_create(name);
+
+    if ((v->flags & VARIABLE_FLAG_READONLY) && (clear & VARIABLE_FLAG_READONLY)) {
+        fprintf(stderr, "essence: %s: readonly variable\n", name);
+        return -1;
+    }
+
+    int old = v->flags;
+    v->flags = (v->flags | set) & ~clear;
+
+    if ((old ^ v->flags) & VARIABLE_FLAG_EXPORT) variable_export_generation++;
+    return 0;
+}
+
+/**
+ * @brief Unset a variable
+ * @param name The variable name
+ * @returns 0 on success
+ */
+int variable_unset(const char *name) {
+    variable_t *v = variable_find(name);
+    if (!v) return 0;
+
+    if (v->flags & VARIABLE_FLAG_READONLY) {
+        fprintf(stderr, "essence: %s: cannot unset: readonly variable\n", name);
+        return -1;
+    }
+
+    if (v->flags & VARIABLE_FLAG_EXPORT) variable_export_generation++;
+
+    if (v->array) {
+        variable_clearArray(v);
+        free(v->array);
+        v->array = NULL;
+        v->type = VARIABLE_TYPE_SCALAR;
+    }
+
+    free(v->value);
+    v->value = NULL;
+    v->value_size = 0;
+    v->flags = 0;
+    return 0;
+}
+
+/**
+ * @brief Build the environment for a spawned command
+ * @returns A NULL-terminated NAME=VALUE list of exported variables, owned by the variable store
+ */
+char **variable_environ() {
+    if (variable_environ_cache && variable_environ_generation == variable_export_generation) {
+        return variable_environ_cache;
+    }
+
+    if (variable_environ_cache) {
+        for (char **e = variable_environ_cache; *e; e++) free(*e);
+        free(variable_environ_cache);
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < variable_table_size; i++) {
+        variable_t *v = variable_table[i];
+        if (v && v->value && (v->flags & VARIABLE_FLAG_EXPORT)) count++;
+    }
+
+    variable_environ_cache = malloc(sizeof(char*) * (count + 1));
+
+    size_t idx = 0;
+    for (size_t i = 0; i < variable_table_size; i++) {
+        variable_t *v = variable_table[i];
+        if (!v || !v->value || !(v->flags & VARIABLE_FLAG_EXPORT)) continue;
+
+        size_t namelen = strlen(v->name);
+        size_t valuelen = strlen(v->value);
+        char *entry = malloc(namelen + valuelen + 2);
+        memcpy(entry, v->name, namelen);
+        entry[namelen] = '=';
+        memcpy(entry + namelen + 1, v->value, valuelen + 1);
+        variable_environ_cache[idx++] = entry;
+    }
+
+    variable_environ_cache[idx] = NULL;
+    variable_environ_generation = variable_export_generation;
+    return variable_environ_cache;
+}
+
+/**
+ * @brief Rebuild the index of an associative array, dropping unset elements
+ */
+static void variable_assocRebuild(variable_array_t *a) {
+    size_t live = 0;
+    for (size_t i = 0; i < a->element_count; i++) {
+        if (!a->elements[i].value) { free(a->elements[i].key); continue; }
+        a->elements[live++] = a->elements[i];
+    }
+    a->element_count = live;
+
+    size_t size = 16;
+    while (size * 7 <= (live + 1) * 20) size *= 2;
+
+    free(a->index);
+    a->index = calloc(size, sizeof(size_t));
+    a->index_size = size;
+
+    for (size_t i = 0; i < live; i++) {
+        size_t j = a->elements[i].hash & (size - 1);
+        while (a->index[j]) j = (j + 1) & (size - 1);
+        a->index[j] = i + 1;
+    }
+}
+
+/**
+ * @brief Make room for one more element
+ */
+static void variable_reserve(variable_array_t *a, size_t count) {
+    if (count <= a->element_size) return;
+
+    size_t size = a->element_size ? a->element_size * 2 : 16;
+    while (size < count) size *= 2;
+
+    a->elements = realloc(a->elements, size * sizeof(variable_element_t));
+    memset(&a->elements[a->element_size], 0, (size - a->element_size) * sizeof(variable_element_t));
+    a->element_size = size;
+}
+
+/**
+ * @brief Find an element of an associative array
+ * @param create Create the element (unset) if it does not exist
+ */
+static variable_element_t *variable_assocFind(variable_array_t *a, const char *key, int create) {
+    if (create && (a->element_count + 1) * 10 >= a->index_size * 7) variable_assocRebuild(a);
+    if (!a->index_size) return NULL;
+
+    unsigned int hash = variable_hash(key, strlen(key));
+    size_t mask = a->index_size - 1;
+    size_t i = hash & mask;
+
+    while (a->index[i]) {
+        variable_element_t *e = &a->elements[a->index[i] - 1];
+        if (e->hash == hash && !strcmp(e->key, key)) return e;
+        i = (i + 1) & mask;
+    }
+
+    if (!create) return NULL;
+
+    variable_reserve(a, a->element_count + 1);
+    variable_element_t *e = &a->elements[a->element_count++];
+    e->key = strdup(key);
+    e->value = NULL;
+    e->hash = hash;
+    a->index[i] = a->element_count;
+    return e;
+}
+
+/**
+ * @brief Get one past the highest set index of an indexed array
+ */
+static long long variable_end(variable_array_t *a) {
+    if (!a->sparse) return a->element_count;
+    return a->element_count ? a->elements[a->element_count - 1].index + 1 : 0;
+}
+
+/**
+ * @brief Put the elements of an indexed array back at their indices
+ */
+static void variable_indexDense(variable_array_t *a) {
+    size_t end = variable_end(a);
+    size_t size = 16;
+    while (size < end) size *= 2;
+
+    variable_element_t *elements = calloc(size, sizeof(variable_element_t));
+    for (size_t i = 0; i < a->element_count; i++) elements[a->elements[i].index] = a->elements[i];
+
+    free(a->elements);
+    a->elements = elements;
+    a->element_size = size;
+    a->element_count = end;
+    a->sparse = 0;
+}
+
+/**
+ * @brief Keep only the set elements of an indexed array, sorted by index
+ */
+static void variable_indexSparse(variable_array_t *a) {
+    size_t live = 0;
+    for (size_t i = 0; i < a->element_count; i++) {
+        if (!a->elements[i].value) continue;
+        a->elements[live] = a->elements[i];
+        a->elements[live++].index = i;
+    }
+
+    a->element_count = live;
+    a->sparse = 1;
+
+    // Give back what the vector had grown to
+    size_t size = 16;
+    while (size < live + 1) size *= 2;
+    if (size < a->element_size) {
+        a->elements = realloc(a->elements, size * sizeof(variable_element_t));
+        a->element_size = size;
+    }
+}
+
+/**
+ * @brief Find an element of an indexed array
+ * @param create Create the element (unset) if it does not exist
+ */
+static variable_element_t *variable_indexFind(variable_array_t *a, long long index, int create) {
+    if (a->sparse && create) {
+        // Back to a vector once at least half of it would be used
+        long long end = variable_end(a);
+        if (index >= end) end = index + 1;
+        if ((size_t)end <= (a->count + 1) * 2) variable_indexDense(a);
+    }
+
+    if (!a->sparse) {
+        if (index >= (long long)a->element_count) {
+            if (!create) return NULL;
+
+            // Only grow the vector while at least about half of it is used
+            if ((unsigned long long)index < (a->count + 1) * 2 + 16) {
+                variable_reserve(a, index + 1);
+                a->element_count = index + 1;
+            } else {
+                variable_indexSparse(a);
+                return variable_indexFind(a, index, create);
+            }
+        }
+
+        variable_element_t *e = &a->elements[index];
+        e->index = index;
+        return e;
+    }
+
+    size_t low = 0, high = a->element_count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (a->elements[mid].index < index) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low < a->element_count && a->elements[low].index == index) return &a->elements[low];
+    if (!create) return NULL;
+
+    variable_reserve(a, a->element_count + 1);
+    memmove(&a->elements[low + 1], &a->elements[low], (a->element_count - low) * sizeof(variable_element_t));
+    a->element_count++;
+
+    variable_element_t *e = &a->elements[low];
+    memset(e, 0, sizeof(variable_element_t));
+    e->index = index;
+    return e;
+}
+
+/**
+ * @brief Drop an unset element of an indexed array
+ */
+static void variable_indexDrop(variable_array_t *a, variable_element_t *e) {
+    if (a->sparse) {
+        size_t i = e - a->elements;
+        memmove(e, e + 1, (a->element_count - i - 1) * sizeof(variable_element_t));
+        a->element_count--;
+        return;
+    }
+
+    // Trim unset elements off the end
+    while (a->element_count && !a->elements[a->element_count - 1].value) a->element_count--;
+}
+
+/**
+ * @brief Store an element value
+ */
+static int variable_storeElement(variable_t *v, variable_element_t *e, const char *value, int append) {
+    char *computed;
+    if (variable_compute(v, e->value, value, append, &computed) < 0) return -1;
+
+    if (!e->value) v->array->count++;
+    free(e->value);
+    e->value = computed ? computed : strdup(value);
+    return 0;
+}
+
+/**
+ * @brief Evaluate an indexed array subscript
+ * @returns 0 on success
+ */
+static int variable_subscript(variable_t *v, const char *key, long long *index) {
+    if (arith_evaluate((char*)key, index) < 0) return -1;
+
+    if (*index < 0) {
+        *index += v->array ? variable_end(v->array) : 1;
+        if (*index < 0) {
+            fprintf(stderr, "essence: %s[%s]: bad array subscript\n", v->name, key);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Turn a variable into an array
+ * @param name The variable name
+ * @param type @c VARIABLE_TYPE_INDEXED or @c VARIABLE_TYPE_ASSOC
+ * @returns The variable, or NULL if it can't be converted
+ */
+variable_t *variable_declareArray(const char *name, int type) {
+    variable_t *v = variable_create(name);
+    if (v->type == type) return v;
+    if (!variable_writable(v)) return NULL;
+
+    if (v->type != VARIABLE_TYPE_SCALAR) {
+        fprintf(stderr, "essence: %s: cannot convert %s array to %s array\n", name,
+                    (v->type == VARIABLE_TYPE_ASSOC) ? "associative" : "indexed",
+                    (type == VARIABLE_TYPE_ASSOC) ? "associative" : "indexed");
+        return NULL;
+    }
+
+    // Arrays are never exported
+    if (v->value && (v->flags & VARIABLE_FLAG_EXPORT)) variable_export_generation++;
+
+    v->type = type;
+    v->array = calloc(1, sizeof(variable_array_t));
+
+    // An existing value becomes element 0
+    if (v->value) {
+        variable_element_t *e;
+        if (type == VARIABLE_TYPE_INDEXED) {
+            e = variable_indexFind(v->array, 0, 1);
+        } else {
+            e = variable_assocFind(v->array, "0", 1);
+        }
+
+        e->value = v->value;
+        v->array->count = 1;
+        v->value = NULL;
+        v->value_size = 0;
+    }
+
+    return v;
+}
+
+/**
+ * @brief Remove every element of an array
+ * @param v The array
+ * @returns 0 on success
+ */
+int variable_clearArray(variable_t *v) {
+    variable_array_t *a = v->array;
+    if (!a) return 0;
+
+    for (size_t i = 0; i < a->element_count; i++) {
+        free(a->elements[i].key);
+        free(a->elements[i].value);
+    }
+
+    free(a->elements);
+    free(a->index);
+    memset(a, 0, sizeof(variable_array_t));
+    return 0;
+}
+
+/**
+ * @brief Set an element of an indexed array
+ * @param v The variable (converted to an indexed array if it is a scalar)
+ * @param index The index, negative indices count back from the end
+ * @param value The value
+ * @param append Nonzero for +=
+ * @returns 0 on success
+ */
+int variable_setIndex(variable_t *v, long long index, const char *value, int append) {
+    if (!variable_writable(v)) return -1;
+    if (v->type == VARIABLE_TYPE_SCALAR && !variable_declareArray(v->name, VARIABLE_TYPE_INDEXED)) return -1;
+
+    if (v->type == VARIABLE_TYPE_ASSOC) {
+        char key[32];
+        snprintf(key, sizeof(key), "%lld", index);
+        return variable_setElement(v, key, value, append);
+    }
+
+    variable_array_t *a = v->array;
+    if (index < 0) index += variable_end(a);
+    if (index < 0 || index == LLONG_MAX) {
+        fprintf(stderr, "essence: %s[%lld]: bad array subscript\n", v->name, index);
+        return -1;
+    }
+
+    variable_element_t *e = variable_indexFind(a, index, 1);
+    if (variable_storeElement(v, e, value, append) < 0) {
+        if (!e->value) variable_indexDrop(a, e);
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Get the index an indexed array is appended at (one past the highest set index)
+ * @param v The variable
+ * @returns The index, 0 if it isn't an indexed array
+ */
+long long variable_nextIndex(variable_t *v) {
+    if (v->type != VARIABLE_TYPE_INDEXED) return 0;
+    return variable_end(v->array);
+}
+
+/**
+ * @brief Set an element of an array
+ * @param v The variable (converted to an indexed array if it is a scalar)
+ * @param key The subscript, evaluated arithmetically for indexed arrays
+ * @param value The value
+ * @param append Nonzero for +=
+ * @returns 0 on success
+ */
+int variable_setElement(variable_t *v, const char *key, const char *value, int append) {
+    if (!variable_writable(v)) return -1;
+
+    if (v->type != VARIABLE_TYPE_ASSOC) {
+        long long index;
+        if (arith_evaluate((char*)key, &index) < 0) return -1;
+        return variable_setIndex(v, index, value, append);
+    }
+
+    return variable_storeElement(v, variable_assocFind(v->array, key, 1), value, append);
+}
+
+/**
+ * @brief Get an element of an array
+ * @param v The variable (a scalar only has element 0)
+ * @param key The subscript
+ * @returns The value, or NULL if unset
+ */
+const char *variable_getElement(variable_t *v, const char *key) {
+    if (v->type == VARIABLE_TYPE_ASSOC) {
+        variable_element_t *e = variable_assocFind(v->array, key, 0);
+        return e ? e->value : NULL;
+    }
+
+    long long index;
+    if (variable_subscript(v, key, &index) < 0) return NULL;
+
+    if (v->type == VARIABLE_TYPE_SCALAR) return index ? NULL : v->value;
+
+    variable_element_t *e = variable_indexFind(v->array, index, 0);
+    return e ? e->value : NULL;
+}
+
+/**
+ * @brief Unset an element of an array
+ * @param v The variable
+ * @param key The subscript
+ * @returns 0 on success
+ */
+int variable_unsetElement(variable_t *v, const char *key) {
+    if (!variable_writable(v)) return -1;
+
+    if (v->type == VARIABLE_TYPE_SCALAR) {
+        long long index;
+        if (variable_subscript(v, key, &index) < 0) return -1;
+        return index ? 0 : variable_unset(v->name);
+    }
+
+    variable_array_t *a = v->array;
+    variable_element_t *e = NULL;
+
+    if (v->type == VARIABLE_TYPE_ASSOC) {
+        e = variable_assocFind(a, key, 0);
+    } else {
+        long long index;
+        if (variable_subscript(v, key, &index) < 0) return -1;
+        e = variable_indexFind(a, index, 0);
+    }
+
+    if (!e || !e->value) return 0;
+
+    free(e->value);
+    e->value = NULL;
+    a->count--;
+
+    if (v->type == VARIABLE_TYPE_INDEXED) variable_indexDrop(a, e);
+
+    return 0;
+}
+
+/**
+ * @brief Iterate over the set elements of an array
+ * @param v The array
+ * @param cursor Iteration cursor, start at 0
+ * @returns The next element, or NULL at the end
+ */
+variable_element_t *variable_iterate(variable_t *v, size_t *cursor) {
+    variable_array_t *a = v->array;
+    if (!a) return NULL;
+
+    while (*cursor < a->element_count) {
+        variable_element_t *e = &a->elements[(*cursor)++];
+        if (e->value) return e;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Count the set elements of a variable
+ */
+size_t variable_count(variable_t *v) {
+    if (v->array) return v->array->count;
+    return v->value ? 1 : 0;
+}
+
+/**
+ * @brief Sort comparator for variable listings
+ */
+static int variable_compare(const void *a, const void *b) {
+    return strcmp((*(variable_t**)a)->name, (*(variable_t**)b)->name);
+}
+
+/**
+ * @brief Get every declared variable, sorted by name
+ * @param count Output count
+ * @returns An allocated list, free with free()
+ */
+variable_t **variable_list(size_t *count) {
+    variable_t **list = malloc(sizeof(variable_t*) * (variable_table_count + 1));
+    size_t idx = 0;
+
+    for (size_t i = 0; i < variable_table_size; i++) {
+        if (!variable_table[i]) continue;
+        variable_refresh(variable_table[i]);
+        list[idx++] = variable_table[i];
+    }
+
+    qsort(list, idx, sizeof(variable_t*), variable_compare);
+    *count = idx;
+    return list;
+}
+
+/**
+ * @brief Initialize the variable store
+ * @param envp The environment to import, every entry becomes an exported variable
+ */
+void variable_init(char **envp) {
+    if (!variable_table) variable_grow();
+
+    for (char **e = envp; e && *e; e++) {
+        char *eq = strchr(*e, '=');
+        if (!eq || eq == *e) continue;
+
+        char name[256];
+        size_t length = eq - *e;
+        if (length >= sizeof(name)) continue;
+        memcpy(name, *e, length);
+        name[length] = 0;
+
+        variable_t *v = variable_create(name);
+        v->flags |= VARIABLE_FLAG_EXPORT;
+        variable_store(v, eq + 1, strlen(eq + 1));
+    }
+}
@@ -0,0 +1,225 @@
+/**
+ * @file vm.c
+ * @brief Virtual machine for precompiled scripts
+ *
+ * Runs the output of compile.c. Words are built in registers with the same
+ * expansion functions the parser uses, so a compiled script behaves like the
+ * source, but nothing is lexed or parsed at run time. Programs are validated
+ * once when they are loaded, the dispatch loop does no bounds checking.
+ *
+ * @copyright
+ * This file is part of the Ethereal Operating System.
+ * It is released under the terms of the BSD 3-clause license.
+ * Please see the LICENSE file in the main repository for more details.
+ *
+ * Copyright (C) 2025 Samuel Stuart
+ */
+
+#include "essence.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Current command being built */
+#define CMD                 (cmds[cmd_count-1])
+
+/**
+ * @brief Check whether some data is a compiled program
+ */
+int vm_isProgram(const char *data, size_t length) {
+    return length >= sizeof(vm_header_t) && !memcmp(data, VM_MAGIC, 4);
+}
+
+/**
+ * @brief Load and validate a compiled program
+ * @param name The file name, for error messages
+ * @param data The program (must stay valid while it runs)
+ * @param length The length of the program
+ * @param program Output program
+ * @returns 0 on success
+ */
+int vm_load(const char *name, const char *data, size_t length, vm_program_t *program) {
+    const vm_header_t *header = (const vm_header_t*)data;
+
+    if (!vm_isProgram(data, length)) goto _bad;
+
+    if (header->version != VM_VERSION) {
+        fprintf(stderr, "essence: %s: compiled by an incompatible version, recompile it\n", name);
+        return -1;
+    }
+
+    size_t code_size = (size_t)header->code_count * sizeof(vm_instruction_t);
+    if (!header->code_count || !header->pool_size) goto _bad;
+    if (length - sizeof(vm_header_t) < code_size || length - sizeof(vm_header_t) - code_size != header->pool_size) goto _bad;
+
+    program->code = (const vm_instruction_t*)(data + sizeof(vm_header_t));
+    program->code_count = header->code_count;
+    program->pool = data + sizeof(vm_header_t) + code_size;
+    program->pool_size = header->pool_size;
+
+    // Everything the dispatch loop trusts is checked here
+    if (program->pool[program->pool_size - 1]) goto _bad;
+    if (program->code[program->code_count - 1].op != VM_OP_END) goto _bad;
+
+    for (size_t i = 0; i < program->code_count; i++) {
+        const vm_instruction_t *in = &program->code[i];
+        if (in->op >= VM_OP_COUNT || in->reg >= VM_REGISTERS) goto _bad;
+
+        switch (in->op) {
+            case VM_OP_LITERAL:
+            case VM_OP_VARIABLE:
+            case VM_OP_PARAMETER:
+            case VM_OP_SUBSTITUTE:
+                if (in->arg >= program->pool_size) goto _bad;
+                break;
+
+            case VM_OP_JUMP:
+            case VM_OP_JUMPNZ:
+            case VM_OP_LOOP:
+                if (in->arg >= program->code_count) goto _bad;
+                break;
+
+            case VM_OP_REDIRECT:
+                if ((in->flags & ~VM_REDIRECT_APPEND) > STDERR_FILENO) goto _bad;
+                break;
+        }
+    }
+
+    return 0;
+
+_bad:
+    fprintf(stderr, "essence: %s: not a valid compiled script\n", name);
+    return -1;
+}
+
+/**
+ * @brief Run a compiled program
+ * @param program The program
+ * @returns @c cmd_last_exit_status
+ */
+int vm_run(const vm_program_t *program) {
+    buffer_t *reg[VM_REGISTERS];
+    for (int i = 0; i < VM_REGISTERS; i++) reg[i] = buffer_create(512);
+
+    command_t *cmds = COMMAND_LIST_INIT();
+    int cmd_count = 1;
+
+    // Set when a redirection fails, the rest of the list is skipped
+    int failed = 0;
+
+    size_t pc = 0;
+    while (1) {
+        const vm_instruction_t *in = &program->code[pc++];
+        buffer_t *r = reg[in->reg];
+        char *k = (char*)program->pool + in->arg;
+
+        if (failed && in->op != VM_OP_EXECUTE && in->op != VM_OP_END) continue;
+
+        switch (in->op) {
+            case VM_OP_END:
+                goto _done;
+
+            case VM_OP_LINE:
+                input_setLine(in->arg);
+                break;
+
+            case VM_OP_LITERAL:
+                buffer_pushString(r, k);
+                break;
+
+            case VM_OP_VARIABLE:
+                expand_variable(k, r, in->flags);
+                break;
+
+            case VM_OP_SPECIAL:
+                expand_special(in->arg, r, in->flags);
+                break;
+
+            case VM_OP_PARAMETER:
+                expand_parameter(k, r, in->flags);
+                break;
+
+            case VM_OP_SUBSTITUTE:
+                expand_substitution(k, r, in->flags);
+                break;
+
+            case VM_OP_HOME: {
+                const char *home = variable_get("HOME");
+                buffer_pushString(r, (char*)(home ? home : "/root/"));
+                break;
+            }
+
+            case VM_OP_WORD:
+                // A word that expanded to nothing is dropped, as in the parser
+                if (r->bufidx) expand_pushWord(&CMD, r->buffer);
+                r->bufidx = 0;
+                r->buffer[0] = 0;
+                break;
+
+            case VM_OP_ASSIGN: {
+                buffer_t *value = reg[VM_REG_VALUE];
+                char *statement = malloc(r->bufidx + value->bufidx + 2);
+                sprintf(statement, "%s=%s", r->buffer, value->buffer);
+                COMMAND_PUSH_ENVIRON(&CMD, statement);
+
+                r->bufidx = value->bufidx = 0;
+                r->buffer[0] = value->buffer[0] = 0;
+                break;
+            }
+
+            case VM_OP_REDIRECT:
+                if (command_redirect(&CMD, in->flags & ~VM_REDIRECT_APPEND, (in->flags & VM_REDIRECT_APPEND) ? COMMAND_REDIRECT_APPEND : 0, r->buffer) < 0) {
+                    // Drop this command, the ones before it still run
+                    command_cleanup(&CMD);
+                    cmd_count--;
+                    failed = 1;
+                }
+
+                r->bufidx = 0;
+                r->buffer[0] = 0;
+                break;
+
+            case VM_OP_COMMAND:
+                COMMAND_NEW(cmds, (cmd_count+1));
+                cmd_count += 1;
+                CMD.exec_flags |= in->flags;
+                break;
+
+            case VM_OP_EXECUTE:
+                command_executeList(cmds, cmd_count);
+
+                for (int i = 0; i < cmd_count; i++) command_cleanup(&cmds[i]);
+                cmds = realloc(cmds, sizeof(command_t));
+                COMMAND_INIT(cmds);
+                cmd_count = 1;
+
+                for (int i = 0; i < VM_REGISTERS; i++) {
+                    reg[i]->bufidx = 0;
+                    reg[i]->buffer[0] = 0;
+                }
+
+                failed = 0;
+                break;
+
+            case VM_OP_JUMP:
+                pc = in->arg;
+                break;
+
+            case VM_OP_JUMPNZ:
+                if (cmd_last_exit_status || ((in->flags & VM_JUMP_SIGNALLED) && cmd_last_signalled)) pc = in->arg;
+                break;
+
+            case VM_OP_LOOP:
+                if (!cmd_last_signalled) pc = in->arg;
+                break;
+        }
+    }
+
+_done:
+    for (int i = 0; i < cmd_count; i++) command_cleanup(&cmds[i]);
+    free(cmds);
+
+    for (int i = 0; i < VM_REGISTERS; i++) buffer_destroy(reg[i]);
+    return cmd_last_exit_status;
+}